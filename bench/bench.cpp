@@ -0,0 +1,89 @@
+#include "bench.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+namespace {
+	struct Benchmark {
+		const char* name;
+		int (*run)(int argc, char** argv);
+	};
+
+	constexpr Benchmark benchmarks[] = {
+	    {"objparser", objparser_bench},
+	    {"lightsystem", lightsystem_bench},
+	    {"jobsystem", jobsystem_bench},
+	    {"lightclusters", lightclusters_bench},
+	    {"lightculling", lightculling_bench},
+	};
+}
+
+std::vector<std::size_t> parse_counts(int argc, char** argv, std::vector<std::size_t> defaults) {
+	if (argc <= 0) {
+		return defaults;
+	}
+
+	std::vector<std::size_t> counts;
+	for (int i = 0; i < argc; ++i) {
+		counts.push_back(std::strtoul(argv[i], nullptr, 10));
+	}
+	return counts;
+}
+
+std::vector<Demo_Light> make_demo_lights(std::size_t count) {
+	// The distributions main() uses
+	std::mt19937 prng(1);
+	std::uniform_real_distribution<float> color_distribution(0, 1);
+	std::uniform_real_distribution<float> intensity_distribution(0.1f, 5);
+	std::uniform_real_distribution<float> position_dist_distribution(1, 30);
+	std::uniform_real_distribution<float> position_orbit_distribution(0.0f, 6.28318530718f);
+
+	std::vector<Demo_Light> lights(count);
+	for (auto& l : lights) {
+		// One draw per statement, argument evaluation order would make the set compiler dependent
+		float r = color_distribution(prng);
+		float g = color_distribution(prng);
+		float b = color_distribution(prng);
+		l.color = glm::normalize(glm::vec3(r, g, b)) * intensity_distribution(prng);
+
+		l.distance = position_dist_distribution(prng);
+		l.orbit    = position_orbit_distribution(prng);
+		l.height   = -2.5f;
+	}
+	return lights;
+}
+
+Light_System make_light_system(const std::vector<Demo_Light>& lights) {
+	Light_System system;
+	system.reserve(lights.size());
+	for (auto& l : lights) {
+		system.add(l.distance, l.orbit, l.height, l.color);
+	}
+	return system;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		int ret = 0;
+		for (auto& b : benchmarks) {
+			std::cout << "=== " << b.name << " ===\n";
+			ret |= b.run(0, nullptr);
+		}
+		return ret;
+	}
+
+	for (auto& b : benchmarks) {
+		if (std::strcmp(argv[1], b.name) == 0) {
+			return b.run(argc - 2, argv + 2);
+		}
+	}
+
+	std::cerr << "Unknown benchmark " << argv[1] << ". Available:";
+	for (auto& b : benchmarks) {
+		std::cerr << ' ' << b.name;
+	}
+	std::cerr << '\n';
+	return 1;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../src/jobsystem.hpp"
+#include "../src/lightsystem.hpp"
+
+// Each benchmark gets the arguments following its name on the command line.
+int objparser_bench(int argc, char** argv);
+int lightsystem_bench(int argc, char** argv);
+int jobsystem_bench(int argc, char** argv);
+int lightclusters_bench(int argc, char** argv);
+int lightculling_bench(int argc, char** argv);
+
+// Seconds elapsed running func once.
+template <class Func>
+double time_once(Func&& func) {
+	auto start = std::chrono::steady_clock::now();
+	func();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(end - start).count();
+}
+
+// Best time over enough runs to fill min_seconds, capped at max_runs.
+template <class Func>
+double time_best(Func&& func, double min_seconds = 0.5, std::size_t max_runs = 1000) {
+	double best  = time_once(func);
+	double total = best;
+	for (std::size_t i = 1; i < max_runs && total < min_seconds; ++i) {
+		double t = time_once(func);
+		best     = t < best ? t : best;
+		total += t;
+	}
+	return best;
+}
+
+// Counts given as arguments, or defaults if there are none.
+std::vector<std::size_t> parse_counts(int argc, char** argv, std::vector<std::size_t> defaults);
+
+struct Demo_Light {
+	float distance;
+	float orbit;
+	float height;
+	glm::vec3 color;
+};
+
+// Lights as the demo creates them, seeded so every run gets the same set.
+std::vector<Demo_Light> make_demo_lights(std::size_t count);
+Light_System make_light_system(const std::vector<Demo_Light>& lights);
+
+// Calls func(jobs, threads) with a job system of every size from 1 thread to one per core.
+template <class Func>
+void sweep_threads(Func&& func) {
+	std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+	for (std::size_t threads = 1; threads <= cores; ++threads) {
+		Job_System jobs(threads);
+		func(jobs, threads);
+	}
+}
+
+// The lights and threads columns that thread sweep tables start with, leaves std::cout right aligned.
+template <class Lights, class Threads>
+std::ostream& sweep_columns(const Lights& lights, const Threads& threads) {
+	return std::cout << std::left << std::setw(10) << lights << std::setw(10) << threads << std::right;
+}
@@ -0,0 +1,46 @@
+#include "bench.hpp"
+
+#include <glm/glm.hpp>
+
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "../src/jobsystem.hpp"
+#include "../src/lightsystem.hpp"
+
+// Light_System::update frame time on 1 to N threads of the job system.
+int jobsystem_bench(int argc, char** argv) {
+	auto counts = parse_counts(argc, argv, {1000, 10000, 100000, 1000000});
+
+	std::cout << "kernel: " << Light_System::kernel_name(Light_System().get_kernel()) << '\n';
+	sweep_columns("lights", "threads") << std::setw(12) << "ms/frame" << std::setw(10) << "speedup" << '\n';
+
+	for (auto count : counts) {
+		Light_System lights = make_light_system(make_demo_lights(count));
+
+		std::vector<glm::vec4> view_positions(count);
+		std::vector<glm::mat4> volume_matrices(count);
+		std::vector<glm::mat4> sprite_matrices(count);
+
+		Light_Targets targets;
+		targets.view_positions  = view_positions.data();
+		targets.volume_matrices = volume_matrices.data();
+		targets.sprite_matrices = sprite_matrices.data();
+
+		glm::mat4 view;
+		double single = 0;
+
+		sweep_threads([&](Job_System& jobs, std::size_t threads) {
+			double time = time_best([&] { lights.update(0.001f, view, targets, &jobs); });
+			if (threads == 1) {
+				single = time;
+			}
+
+			sweep_columns(count, threads) << std::fixed << std::setprecision(3) << std::setw(12) << time * 1e3
+			                              << std::setw(10) << std::setprecision(2) << single / time << '\n';
+		});
+	}
+
+	return 0;
+}
@@ -0,0 +1,76 @@
+#include "bench.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "../src/jobsystem.hpp"
+#include "../src/lightclusters.hpp"
+#include "../src/lightsystem.hpp"
+
+// Light_Clusters::build time for the demo's orbiting lights at 1280x720, on 1 to N threads.
+int lightclusters_bench(int argc, char** argv) {
+	auto counts = parse_counts(argc, argv, {1000, 10000, 100000});
+
+	constexpr std::size_t width  = 1280;
+	constexpr std::size_t height = 720;
+	constexpr float z_near       = 0.5f;
+	constexpr float z_far        = 1000.0f;
+
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), float(width) / height, z_near, z_far);
+	glm::mat4 view       = glm::translate(glm::mat4(), glm::vec3(0, -3, -35));
+
+	int ret = 0;
+
+	sweep_columns("lights", "threads") << std::setw(12) << "ms/build" << std::setw(10) << "speedup" << std::setw(14)
+	                                   << "indices" << std::setw(14) << "avg/cluster" << '\n';
+
+	for (auto count : counts) {
+		Light_System lights = make_light_system(make_demo_lights(count));
+
+		std::vector<glm::vec4> view_positions(count);
+		Light_Targets targets;
+		targets.view_positions = view_positions.data();
+		lights.update(0, view, targets);
+
+		Light_Clusters reference;
+		reference.build(view_positions.data(), count, projection, z_near, z_far, width, height);
+
+		std::size_t occupied = 0;
+		for (auto& c : reference.get_clusters()) {
+			occupied += c.y != 0;
+		}
+
+		double single = 0;
+		sweep_threads([&](Job_System& jobs, std::size_t threads) {
+			Light_Clusters clusters;
+			double time = time_best(
+			    [&] { clusters.build(view_positions.data(), count, projection, z_near, z_far, width, height, &jobs); });
+			if (threads == 1) {
+				single = time;
+			}
+
+			// The output is defined to be the same however the work was split
+			bool same = clusters.get_indices() == reference.get_indices() &&
+			            std::equal(clusters.get_clusters().begin(), clusters.get_clusters().end(),
+			                       reference.get_clusters().begin(), [](const glm::uvec2& a, const glm::uvec2& b) {
+				                       return a.x == b.x && a.y == b.y;
+			                       });
+			if (!same) {
+				std::cerr << "Cluster lists differ from the single threaded build\n";
+				ret = 1;
+			}
+
+			sweep_columns(count, threads) << std::fixed << std::setprecision(3) << std::setw(12) << time * 1e3
+			                              << std::setw(10) << std::setprecision(2) << single / time << std::setw(14)
+			                              << reference.get_indices().size() << std::setw(14) << std::setprecision(1)
+			                              << (occupied ? double(reference.get_indices().size()) / occupied : 0.0) << '\n';
+		});
+	}
+
+	return ret;
+}
@@ -0,0 +1,137 @@
+#include "bench.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "../src/jobsystem.hpp"
+#include "../src/lightculling.hpp"
+#include "../src/lightsystem.hpp"
+
+namespace {
+	constexpr std::size_t width     = 1280;
+	constexpr std::size_t height    = 720;
+	constexpr std::size_t tile_size = 16;
+	constexpr float z_near          = 0.5f;
+	constexpr float z_far           = 1000.0f;
+
+	// View space spheres of the demo's lights
+	std::vector<glm::vec4> view_lights(std::size_t count, const glm::mat4& view) {
+		Light_System lights = make_light_system(make_demo_lights(count));
+
+		std::vector<glm::vec4> view_positions(count);
+		Light_Targets targets;
+		targets.view_positions = view_positions.data();
+		lights.update(0, view, targets);
+		return view_positions;
+	}
+
+	// Every light against every tile, straight from the definitions
+	bool matches_brute_force(const Light_Tiles& tiles, const std::vector<glm::vec4>& lights, const glm::mat4& projection) {
+		Frustum frustum = make_frustum(projection);
+
+		for (std::size_t ty = 0; ty < tiles.grid_height(); ++ty) {
+			for (std::size_t tx = 0; tx < tiles.grid_width(); ++tx) {
+				float ndc_x[2] = {2.0f * std::min(tx * tile_size, width) / width - 1,
+				                  2.0f * std::min((tx + 1) * tile_size, width) / width - 1};
+				float ndc_y[2] = {2.0f * std::min(ty * tile_size, height) / height - 1,
+				                  2.0f * std::min((ty + 1) * tile_size, height) / height - 1};
+
+				std::vector<std::uint32_t> expected;
+				for (std::size_t i = 0; i < lights.size(); ++i) {
+					const glm::vec4& l = lights[i];
+					if (!sphere_in_frustum(frustum, l)) {
+						continue;
+					}
+
+					// Signed distances to the planes through the eye and each tile edge
+					auto distance = [](float p, float ndc, float x, float z) { return (p * x + ndc * z) / std::sqrt(p * p + ndc * ndc); };
+					if (distance(projection[0][0], ndc_x[0], l.x, l.z) >= -l.w &&
+					    -distance(projection[0][0], ndc_x[1], l.x, l.z) >= -l.w &&
+					    distance(projection[1][1], ndc_y[0], l.y, l.z) >= -l.w &&
+					    -distance(projection[1][1], ndc_y[1], l.y, l.z) >= -l.w) {
+						expected.push_back(static_cast<std::uint32_t>(i));
+					}
+				}
+
+				glm::uvec2 t = tiles.get_tiles()[ty * tiles.grid_width() + tx];
+				auto begin   = tiles.get_indices().begin() + t.x;
+				if (expected.size() != t.y || !std::equal(expected.begin(), expected.end(), begin)) {
+					std::cerr << "Tile " << tx << ", " << ty << " has " << t.y << " lights, expected " << expected.size() << '\n';
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// FNV-1a over the tile lists, so big reference builds needn't stay in memory
+	std::uint64_t checksum(const Light_Tiles& tiles) {
+		std::uint64_t hash = 14695981039346656037ull;
+		auto mix           = [&](std::uint32_t v) { hash = (hash ^ v) * 1099511628211ull; };
+		for (auto& t : tiles.get_tiles()) {
+			mix(t.x);
+			mix(t.y);
+		}
+		for (auto i : tiles.get_indices()) {
+			mix(i);
+		}
+		return hash;
+	}
+} // namespace
+
+// Light_Tiles::build on seeded light sets, checked against brute force where that's affordable.
+int lightculling_bench(int argc, char** argv) {
+	auto counts = parse_counts(argc, argv, {1000, 10000, 100000, 1000000});
+
+	// The demo's starting camera
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), float(width) / height, z_near, z_far);
+	glm::mat4 view       = glm::translate(glm::mat4(), glm::vec3(0, -10, -25));
+
+	int ret = 0;
+
+	sweep_columns("lights", "threads") << std::setw(12) << "ms/build" << std::setw(12) << "lights/ms" << std::setw(10)
+	                                   << "speedup" << std::setw(10) << "visible" << std::setw(12) << "indices" << '\n';
+
+	for (auto count : counts) {
+		auto lights = view_lights(count, view);
+
+		std::uint64_t reference;
+		{
+			Light_Tiles tiles;
+			tiles.build(lights.data(), count, projection, z_near, width, height, tile_size);
+			reference = checksum(tiles);
+			if (count <= 10000 && !matches_brute_force(tiles, lights, projection)) {
+				std::cerr << "Tile lists for " << count << " lights don't match brute force\n";
+				ret = 1;
+			}
+		}
+
+		double single = 0;
+		sweep_threads([&](Job_System& jobs, std::size_t threads) {
+			Light_Tiles tiles;
+			double time = time_best([&] { tiles.build(lights.data(), count, projection, z_near, width, height, tile_size, &jobs); });
+			if (threads == 1) {
+				single = time;
+			}
+
+			if (checksum(tiles) != reference) {
+				std::cerr << "Tile lists on " << threads << " threads differ from the single threaded build\n";
+				ret = 1;
+			}
+
+			sweep_columns(count, threads) << std::fixed << std::setprecision(3) << std::setw(12) << time * 1e3
+			                              << std::setprecision(0) << std::setw(12) << count / (time * 1e3)
+			                              << std::setprecision(2) << std::setw(10) << single / time << std::setw(10)
+			                              << tiles.visible_count() << std::setw(12) << tiles.get_indices().size() << '\n';
+		});
+	}
+
+	return ret;
+}
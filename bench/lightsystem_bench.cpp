@@ -0,0 +1,137 @@
+#include "bench.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "../src/lightsystem.hpp"
+
+namespace {
+	struct Glm_Lights {
+		struct LightData {
+			float distance;
+			float orbit;
+			float height;
+			float size;
+		};
+
+		std::vector<LightData> lightdata;
+		std::vector<glm::vec3> lightposition;
+		std::vector<glm::mat4> lightworldmatrix;
+		std::vector<glm::mat4> lighteffectworldmatrix;
+
+		// The per light glm::mat4 path Light_System replaced
+		void update(float orbit_delta, const glm::mat4& view) {
+			for (std::size_t i = 0; i < lightdata.size(); ++i) {
+				auto&& lp = lightdata[i];
+				lp.orbit += orbit_delta;
+
+				glm::mat4 height      = glm::translate(glm::mat4(), glm::vec3(0, lp.height, 0));
+				glm::mat4 orbit       = glm::rotate(glm::mat4(), lp.orbit, glm::vec3(0, 1, 0));
+				glm::mat4 trans       = glm::translate(glm::mat4(), glm::vec3(0, 0, -lp.distance));
+				glm::mat4 scale       = glm::scale(glm::mat4(), glm::vec3(lp.size * Light_System::sprite_scale));
+				glm::mat4 effectscale = glm::scale(glm::mat4(), glm::vec3(lp.size));
+
+				glm::mat4 unscaled        = orbit * height * trans;
+				lightposition[i]          = glm::vec3(view * unscaled * glm::vec4(0, 0, 0, 1));
+				lightworldmatrix[i]       = unscaled * scale;
+				lighteffectworldmatrix[i] = unscaled * effectscale;
+			}
+		}
+	};
+
+	struct Light_Outputs {
+		std::vector<glm::vec4> view_positions;
+		std::vector<glm::mat4> volume_matrices;
+		std::vector<glm::mat4> sprite_matrices;
+
+		explicit Light_Outputs(std::size_t count) : view_positions(count), volume_matrices(count), sprite_matrices(count) {}
+
+		Light_Targets targets() {
+			Light_Targets t;
+			t.view_positions  = view_positions.data();
+			t.volume_matrices = volume_matrices.data();
+			t.sprite_matrices = sprite_matrices.data();
+			return t;
+		}
+	};
+
+	float max_difference(const Glm_Lights& ref, const Light_Outputs& out) {
+		float diff = 0;
+		for (std::size_t i = 0; i < out.view_positions.size(); ++i) {
+			for (int e = 0; e < 3; ++e) {
+				diff = std::max(diff, std::abs(ref.lightposition[i][e] - out.view_positions[i][e]));
+			}
+			for (int col = 0; col < 4; ++col) {
+				for (int row = 0; row < 4; ++row) {
+					diff = std::max(diff, std::abs(ref.lighteffectworldmatrix[i][col][row] - out.volume_matrices[i][col][row]));
+					diff = std::max(diff, std::abs(ref.lightworldmatrix[i][col][row] - out.sprite_matrices[i][col][row]));
+				}
+			}
+		}
+		return diff;
+	}
+} // namespace
+
+// Compares the glm light transform loop against every Light_System kernel this CPU supports.
+int lightsystem_bench(int argc, char** argv) {
+	auto counts = parse_counts(argc, argv, {100, 1000, 10000, 100000});
+
+	const Light_System::Kernel kernels[] = {Light_System::Kernel::scalar, Light_System::Kernel::sse4,
+	                                        Light_System::Kernel::avx2};
+
+	glm::mat4 view = glm::lookAt(glm::vec3(3, 4, 5), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+	// Every path runs a different number of iterations, so orbits must not move for the results to be comparable
+	constexpr float orbit_delta = 0.0f;
+	// Largest difference from the glm path a kernel may have, the matrices hold values up to about 30
+	constexpr float tolerance = 1e-4f;
+	int ret                   = 0;
+
+	std::cout << std::left << std::setw(10) << "lights" << std::setw(8) << "kernel" << std::right << std::setw(14)
+	          << "ns/light" << std::setw(10) << "speedup" << std::setw(14) << "max error" << '\n';
+
+	for (auto count : counts) {
+		auto demo           = make_demo_lights(count);
+		Light_System lights = make_light_system(demo);
+		Glm_Lights ref;
+		for (std::size_t i = 0; i < count; ++i) {
+			ref.lightdata.push_back({demo[i].distance, demo[i].orbit, demo[i].height, lights.get_radius(i)});
+		}
+		ref.lightposition.resize(count);
+		ref.lightworldmatrix.resize(count);
+		ref.lighteffectworldmatrix.resize(count);
+
+		Light_Outputs outputs(count);
+		auto targets = outputs.targets();
+
+		double glm_time = time_best([&] { ref.update(orbit_delta, view); });
+		std::cout << std::left << std::setw(10) << count << std::setw(8) << "glm" << std::right << std::fixed
+		          << std::setprecision(2) << std::setw(14) << glm_time * 1e9 / count << std::setw(10) << 1.0
+		          << std::setw(14) << "-" << '\n';
+
+		for (auto k : kernels) {
+			if (!lights.set_kernel(k)) {
+				continue;
+			}
+
+			double time = time_best([&] { lights.update(orbit_delta, view, targets); });
+			float error = max_difference(ref, outputs);
+			if (!(error <= tolerance)) {
+				std::cerr << Light_System::kernel_name(k) << " kernel differs from glm by " << error << " on " << count
+				          << " lights\n";
+				ret = 1;
+			}
+
+			std::cout << std::left << std::setw(10) << count << std::setw(8) << Light_System::kernel_name(k) << std::right
+			          << std::fixed << std::setprecision(2) << std::setw(14) << time * 1e9 / count << std::setw(10)
+			          << glm_time / time << std::setw(14) << std::scientific << std::setprecision(2) << error << '\n';
+		}
+	}
+
+	return ret;
+}
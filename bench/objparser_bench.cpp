@@ -0,0 +1,45 @@
+#include "bench.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/objparser.hpp"
+#include "../src/util.hpp"
+
+// Reports parse throughput of the bundled .wavobj files single threaded and on every core.
+int objparser_bench(int argc, char** argv) {
+	std::vector<std::string> files;
+	for (int i = 0; i < argc; ++i) {
+		files.emplace_back(argv[i]);
+	}
+	if (files.empty()) {
+		files = {"circle.wavobj", "monkey.wavobj", "sphere.wavobj", "square.wavobj",
+		         "teapot.wavobj", "world.wavobj",  "world_detailed.wavobj"};
+	}
+
+	std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+
+	std::cout << std::left << std::setw(24) << "file" << std::right << std::setw(10) << "size" << std::setw(14)
+	          << "1 thread" << std::setw(14) << (std::to_string(cores) + " threads") << '\n';
+
+	for (auto& name : files) {
+		Mapped_File probe(name.c_str());
+		if (!probe.is_open()) {
+			return 1;
+		}
+		double megabytes = probe.size() / (1024.0 * 1024.0);
+
+		double single = time_best([&] { parse_obj_file(name, 1); });
+		double multi  = time_best([&] { parse_obj_file(name, cores); });
+
+		std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(2)
+		          << std::setw(8) << megabytes << "MB" << std::setw(10) << megabytes / single << "MB/s"
+		          << std::setw(10) << megabytes / multi << "MB/s" << '\n';
+	}
+
+	return 0;
+}
@@ -0,0 +1,68 @@
+#version 430 core
+
+// Moves the exposure in a 1x1 image towards the average luminance of the
+// histogram's pixels between lowPercent and highPercent, so a few very dark or
+// very bright pixels don't swing it. Clears the histogram for the next frame.
+
+#define BINS 64
+
+layout (local_size_x = BINS) in;
+
+layout (r32f, binding = 1) uniform image2D exposureImage;
+
+layout (std430, binding = 2) buffer Luminance_Histogram {
+	uint bins[BINS];
+};
+
+uniform float minLogLum;
+uniform float logLumRange;
+uniform float lowPercent;
+uniform float highPercent;
+uniform float deltaTime;
+
+shared uint counts[BINS];
+
+void main() {
+	uint index = gl_LocalInvocationIndex;
+	counts[index] = bins[index];
+	bins[index] = 0u;
+	barrier();
+
+	if (index != 0u) {
+		return;
+	}
+
+	float total = 0.0;
+	for (uint i = 0u; i < uint(BINS); ++i) {
+		total += float(counts[i]);
+	}
+	float low = total * lowPercent;
+	float high = total * highPercent;
+
+	float seen = 0.0;
+	float sum = 0.0;
+	float weight = 0.0;
+	for (uint i = 0u; i < uint(BINS); ++i) {
+		float count = float(counts[i]);
+		float taken = clamp(seen + count, low, high) - clamp(seen, low, high);
+		float luminance = i == 0u ? 0.0 : exp2((float(i) - 0.5) / float(BINS - 1) * logLumRange + minLogLum);
+
+		sum += taken * luminance;
+		weight += taken;
+		seen += count;
+	}
+	float luminosity = weight > 0.0 ? sum / weight : 0.4;
+
+	// Same response as the CPU path: darken quickly, brighten slowly
+	float target = 1.0 / (luminosity + (1.0 - 0.4));
+	float exposure = imageLoad(exposureImage, ivec2(0)).r;
+	float diff = target - exposure;
+	if (diff < 0.0) {
+		exposure += (diff * deltaTime) / 0.5;
+	}
+	else {
+		exposure += min(diff, 0.2 * deltaTime);
+	}
+
+	imageStore(exposureImage, ivec2(0), vec4(exposure));
+}
@@ -0,0 +1,56 @@
+#version 330 core
+
+in vec3 vNormal;
+in vec3 vFragPos;
+in vec3 vTexCoords;
+
+out vec4 FragColor;
+
+// Built on the CPU by Light_Clusters
+uniform usamplerBuffer clusters;     // Offset into lightIndices, light count
+uniform usamplerBuffer lightIndices;
+uniform samplerBuffer lightPositions; // View space position, radius
+uniform samplerBuffer lightColors;
+
+uniform ivec2 gridSize;  // Tiles across and down, each slice
+uniform float tileSize;  // In pixels
+uniform float sliceScale;
+uniform float sliceBias;
+uniform int sliceCount;
+
+void main() {
+	const vec3 viewPos = vec3(0, 0, 0);
+	vec3 normal = normalize(vNormal);
+	vec3 viewDir = normalize(viewPos - vFragPos);
+
+	ivec2 tile = min(ivec2(gl_FragCoord.xy / tileSize), gridSize - 1);
+	int slice = clamp(int(floor(log2(-vFragPos.z) * sliceScale + sliceBias)), 0, sliceCount - 1);
+	uvec2 cluster = texelFetch(clusters, (slice * gridSize.y + tile.y) * gridSize.x + tile.x).xy;
+
+	vec3 result = vec3(0.0);
+	for (uint l = 0u; l < cluster.y; ++l) {
+		int i = int(texelFetch(lightIndices, int(cluster.x + l)).r);
+		vec4 light = texelFetch(lightPositions, i);
+		vec3 lightcolor = texelFetch(lightColors, i).rgb;
+
+		float dist = length(light.xyz - vFragPos);
+		if (dist >= light.w) {
+			continue;
+		}
+
+		// Diffuse
+		vec3 lightDir = (light.xyz - vFragPos) / dist;
+		vec3 diffuse = max(dot(normal, lightDir), 0.0) * lightcolor * vec3(1.0, 0.2176, 0.028991);
+		// Specular
+		vec3 halfwayDir = normalize(lightDir + viewDir);
+		float spec = pow(max(dot(normal, halfwayDir), 0.0), 8.0);
+		vec3 specular = spec * lightcolor;
+		// Attenuation
+		float attenuation = clamp(1.0 - dist / light.w, 0.0, 1.0);
+		attenuation *= attenuation;
+
+		result += (diffuse + specular) * attenuation;
+	}
+
+	FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,16 @@
+// Per frame constants, written once a frame into one std140 block that
+// every program shares. Layout matches Frame_Constants in main.cpp.
+
+#ifndef FRAME_GLSL
+#define FRAME_GLSL
+
+layout (std140) uniform Frame {
+	mat4 view;
+	mat4 projection;
+	mat4 inverseProjection;
+	vec3 viewPos;    // World space camera position
+	float time;      // Seconds since start
+	vec2 resolution; // Screen size in pixels
+};
+
+#endif
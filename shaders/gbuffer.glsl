@@ -0,0 +1,34 @@
+// G-buffer reads shared by every pass that shades from it.
+//
+// COMPACT_GBUFFER drops the position target: view space position is
+// rebuilt from the depth buffer and the inverse projection, and normals
+// are stored octahedral in RG16. Without it position and normal are read
+// straight from their float targets.
+
+#include "frame.glsl"
+#include "octahedral.glsl"
+
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+#ifdef COMPACT_GBUFFER
+vec3 gbuffer_position(vec2 uv) {
+	vec4 ndc = vec4(vec3(uv, texture(gDepth, uv).r) * 2.0 - 1.0, 1.0);
+	vec4 position = inverseProjection * ndc;
+	return position.xyz / position.w;
+}
+
+vec3 gbuffer_normal(vec2 uv) {
+	return oct_decode(texture(gNormal, uv).rg * 2.0 - 1.0);
+}
+#else
+uniform sampler2D gPosition; // View space position
+
+vec3 gbuffer_position(vec2 uv) {
+	return texture(gPosition, uv).xyz;
+}
+
+vec3 gbuffer_normal(vec2 uv) {
+	return normalize(texture(gNormal, uv).rgb);
+}
+#endif
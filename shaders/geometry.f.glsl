@@ -1,18 +1,31 @@
 #version 330 core
 
+#include "octahedral.glsl"
+
 in vec3 vTexCoords;
 in vec3 vNormal;
 in vec3 vFragPos;
 
+#ifdef COMPACT_GBUFFER
+// Position is rebuilt from depth, so only the normal and albedo are written
+layout (location = 0) out vec2 gNormal;
+layout (location = 1) out vec4 gAlbedoSpec;
+#else
 layout (location = 0) out vec3 gPosition;
 layout (location = 1) out vec3 gNormal;
 layout (location = 2) out vec4 gAlbedoSpec;
+#endif
 
 void main() {
+#ifdef COMPACT_GBUFFER
+	// Octahedral normal, remapped for the unorm target
+	gNormal = oct_encode(normalize(vNormal)) * 0.5 + 0.5;
+#else
 	// Position vector
 	gPosition = vFragPos;
 	// Normal vector
 	gNormal = vNormal;
+#endif
 	// Diffuse color
 	gAlbedoSpec.rgb = vec3(1.0, 0.2176, 0.028991);
 	// Specular
@@ -4,18 +4,29 @@ layout (location = 0) in vec3 position;
 layout (location = 1) in vec2 texcoords;
 layout (location = 2) in vec3 normals;
 
+#include "frame.glsl"
+
 uniform mat4 world;
-uniform mat4 view;
-uniform mat4 projection;
+
+// Packed vertices store positions as unorm16 within the object's bounds
+// and normals as octahedral snorm16. Float vertices use scale 1, bias 0.
+uniform vec3 positionScale;
+uniform vec3 positionBias;
+uniform bool octNormals;
 
 out vec3 vNormal;
 out vec3 vFragPos;
 out vec3 vTexCoords;
 
+#include "octahedral.glsl"
+
 void main() {
-	vec4 viewPos = view * world * vec4(position, 1.0);
-    gl_Position = projection * viewPos;
-    vNormal = normalize(mat3(transpose(inverse(view * world))) * normals);
-    vFragPos = vec3(viewPos);
+	vec3 objPos = position * positionScale + positionBias;
+	vec3 objNormal = octNormals ? oct_decode(normals.xy) : normals;
+
+	vec4 viewPosition = view * world * vec4(objPos, 1.0);
+    gl_Position = projection * viewPosition;
+    vNormal = normalize(mat3(transpose(inverse(view * world))) * objNormal);
+    vFragPos = vec3(viewPosition);
     vTexCoords = vec3(0, 0, 0);
-}
\ No newline at end of file
+}
@@ -6,11 +6,15 @@ in vec2 vTexCoords;
 
 uniform sampler2D inval;
 uniform float exposure;
+// Written by the GPU exposure adaptation, used in place of exposure when set
+uniform sampler2D exposureTexture;
+uniform bool gpuExposure;
 
 void main() {
 	vec3 hdrColor = texture(inval, vTexCoords).rgb;
+	float e = gpuExposure ? texelFetch(exposureTexture, ivec2(0), 0).r : exposure;
 
-	vec3 mapped = vec3(1.0) - exp(-hdrColor * exposure);
+	vec3 mapped = vec3(1.0) - exp(-hdrColor * e);
 	mapped = pow(mapped, vec3(1.0 / 2.2));
 
 	FragColor = vec4(mapped, 1.0);
@@ -0,0 +1,44 @@
+#version 330 core
+
+out vec4 FragColor;
+
+#include "gbuffer.glsl"
+
+uniform sampler2D gAlbedoSpec; // Albedo in rgb spec in a
+
+flat in vec3 vColor;
+flat in vec4 vLight; // View space position, radius
+
+void main() {
+	const vec3 eyePos = vec3(0, 0, 0); // Shading is in view space
+
+	vec2 texcoords = (gl_FragCoord.xy / resolution);
+
+	vec3 FragPos = gbuffer_position(texcoords);
+
+	// Only back faces are drawn, so the depth test alone lets through
+	// everything in front of the volume. Reject what's outside the radius
+	// before doing any more work.
+	vec3 toLight = vLight.xyz - FragPos;
+	float dist = length(toLight);
+	if (dist >= vLight.w) {
+		discard;
+	}
+
+	vec3 Normal  = gbuffer_normal(texcoords);
+	vec3 Diffuse = texture(gAlbedoSpec, texcoords).rgb;
+
+	// Diffuse
+	vec3 lightDir = toLight / dist;
+	vec3 diffuse = max(dot(Normal, lightDir), 0.0) * vColor * Diffuse;
+	// Specular
+	vec3 viewDir = normalize(eyePos - FragPos);
+	vec3 halfwayDir = normalize(lightDir + viewDir);
+	float spec = pow(max(dot(Normal, halfwayDir), 0.0), 8.0);
+	vec3 specular = vColor * spec;
+	// Attenuation
+	float attenuation = clamp(1.0 - dist / vLight.w, 0.0, 1.0);
+	attenuation *= attenuation;
+
+	FragColor = vec4((diffuse + specular) * attenuation, 1.0);
+}
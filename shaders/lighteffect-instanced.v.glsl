@@ -0,0 +1,17 @@
+#version 330 core
+
+layout (location = 7) in vec3 position;
+layout (location = 1) in vec3 color;
+layout (location = 2) in mat4 world;
+layout (location = 6) in vec4 light; // View space position, radius
+
+#include "frame.glsl"
+
+flat out vec3 vColor;
+flat out vec4 vLight;
+
+void main() {
+	gl_Position = projection * view * world * vec4(position, 1.0f);
+	vColor = color;
+	vLight = light;
+}
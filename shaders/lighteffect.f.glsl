@@ -2,12 +2,9 @@
 
 out vec4 FragColor;
 
-uniform sampler2D gPosition;   // World space position
-uniform sampler2D gNormal;     // World space normals
-uniform sampler2D gAlbedoSpec; // Albedo in rgb spec in a
+#include "gbuffer.glsl"
 
-// uniform vec3 viewPos; // Viewport position
-uniform vec2 resolution; // Screen Resolution
+uniform sampler2D gAlbedoSpec; // Albedo in rgb spec in a
 
 uniform vec3 lightposition;
 uniform vec3 lightcolor;
@@ -15,13 +12,13 @@ uniform vec3 lightcolor;
 uniform float radius;
 
 void main() {
-    const vec3 viewPos = vec3(0, 0, 0);
+    const vec3 eyePos = vec3(0, 0, 0); // Shading is in view space
 
 	vec2 texcoords = (gl_FragCoord.xy / resolution);
 
 	// Get data from gbuffer
-	vec3 FragPos = texture(gPosition, texcoords).rgb;
-	vec3 Normal  = normalize(texture(gNormal, texcoords).rgb);
+	vec3 FragPos = gbuffer_position(texcoords);
+	vec3 Normal  = gbuffer_normal(texcoords);
 	vec3 Diffuse = texture(gAlbedoSpec, texcoords).rgb;
 	float Spec   = texture(gAlbedoSpec, texcoords).a;
 
@@ -30,7 +27,7 @@ void main() {
     vec3 lightDir = normalize(lightposition - FragPos);
     vec3 diffuse = max(dot(Normal, lightDir), 0.0) * lightcolor * Diffuse;
     // Specular
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(eyePos - FragPos);
     vec3 halfwayDir = normalize(lightDir + viewDir);
     float spec = pow(max(dot(Normal, halfwayDir), 0.0), 8.0);
     vec3 specular = lightcolor * spec;
@@ -0,0 +1,142 @@
+#version 430 core
+
+// One workgroup per 16x16 tile: find the tile's depth range, cull every light
+// against the tile frustum, then shade each pixel from the surviving list.
+
+#define TILE_SIZE 16
+#define MAX_TILE_LIGHTS 1024
+
+layout (local_size_x = TILE_SIZE, local_size_y = TILE_SIZE) in;
+
+layout (rgba16f, binding = 0) uniform image2D lColor;
+
+#include "gbuffer.glsl"
+
+uniform sampler2D gAlbedoSpec; // Albedo in rgb spec in a
+
+layout (std430, binding = 0) readonly buffer Light_Positions {
+	vec4 lightPositions[]; // View space position, radius
+};
+layout (std430, binding = 1) readonly buffer Light_Colors {
+	float lightColors[]; // Tightly packed rgb
+};
+
+uniform uint lightCount;
+uniform bool heatmap;
+
+shared uint tileMinDepth;
+shared uint tileMaxDepth;
+shared uint tileLightCount;
+shared uint tileLights[MAX_TILE_LIGHTS];
+
+float view_depth(float depth) {
+	float ndc = depth * 2.0 - 1.0;
+	return -projection[3][2] / (ndc + projection[2][2]);
+}
+
+vec3 heat(float t) {
+	// Blue -> green -> red
+	return t < 0.5 ? mix(vec3(0, 0, 1), vec3(0, 1, 0), t * 2.0) : mix(vec3(0, 1, 0), vec3(1, 0, 0), t * 2.0 - 1.0);
+}
+
+void main() {
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(lColor);
+	bool inside = pixel.x < size.x && pixel.y < size.y;
+
+	if (gl_LocalInvocationIndex == 0) {
+		tileMinDepth = 0xFFFFFFFFu;
+		tileMaxDepth = 0u;
+		tileLightCount = 0u;
+	}
+	barrier();
+
+	// Positive floats order the same as their bits
+	float depth = inside ? texelFetch(gDepth, pixel, 0).r : 1.0;
+	bool geometry = depth < 1.0;
+	if (geometry) {
+		atomicMin(tileMinDepth, floatBitsToUint(depth));
+		atomicMax(tileMaxDepth, floatBitsToUint(depth));
+	}
+	barrier();
+
+	if (tileMinDepth <= tileMaxDepth) {
+		float near = view_depth(uintBitsToFloat(tileMinDepth));
+		float far = view_depth(uintBitsToFloat(tileMaxDepth));
+
+		// Side planes through the eye; a point is inside when dot(plane, p) >= 0
+		vec2 ndcMin = vec2(gl_WorkGroupID.xy * TILE_SIZE) / vec2(size) * 2.0 - 1.0;
+		vec2 ndcMax = vec2((gl_WorkGroupID.xy + 1) * TILE_SIZE) / vec2(size) * 2.0 - 1.0;
+		vec3 planes[4] = vec3[4](
+			normalize(vec3(projection[0][0], 0, ndcMin.x)),
+			normalize(vec3(-projection[0][0], 0, -ndcMax.x)),
+			normalize(vec3(0, projection[1][1], ndcMin.y)),
+			normalize(vec3(0, -projection[1][1], -ndcMax.y))
+		);
+
+		for (uint i = gl_LocalInvocationIndex; i < lightCount; i += TILE_SIZE * TILE_SIZE) {
+			vec4 light = lightPositions[i];
+			bool visible = light.z - light.w <= near && light.z + light.w >= far;
+			for (int p = 0; p < 4 && visible; ++p) {
+				visible = dot(planes[p], light.xyz) >= -light.w;
+			}
+			if (visible) {
+				uint slot = atomicAdd(tileLightCount, 1u);
+				if (slot < MAX_TILE_LIGHTS) {
+					tileLights[slot] = i;
+				}
+			}
+		}
+	}
+	barrier();
+
+	if (!inside) {
+		return;
+	}
+
+	uint count = min(tileLightCount, uint(MAX_TILE_LIGHTS));
+	vec3 result = vec3(0.0);
+
+	if (geometry) {
+		vec2 uv = (vec2(pixel) + 0.5) / vec2(size);
+		vec3 FragPos = gbuffer_position(uv);
+		vec3 Normal  = gbuffer_normal(uv);
+		vec3 Diffuse = texelFetch(gAlbedoSpec, pixel, 0).rgb;
+		vec3 viewDir = normalize(-FragPos);
+
+		for (uint l = 0; l < count; ++l) {
+			uint i = tileLights[l];
+			vec4 light = lightPositions[i];
+			vec3 color = vec3(lightColors[i * 3], lightColors[i * 3 + 1], lightColors[i * 3 + 2]);
+
+			vec3 toLight = light.xyz - FragPos;
+			float dist = length(toLight);
+			if (dist >= light.w) {
+				continue;
+			}
+
+			// Diffuse
+			vec3 lightDir = toLight / dist;
+			vec3 diffuse = max(dot(Normal, lightDir), 0.0) * color * Diffuse;
+			// Specular
+			vec3 halfwayDir = normalize(lightDir + viewDir);
+			float spec = pow(max(dot(Normal, halfwayDir), 0.0), 8.0);
+			vec3 specular = color * spec;
+			// Attenuation
+			float attenuation = clamp(1.0 - dist / light.w, 0.0, 1.0);
+			attenuation *= attenuation;
+
+			result += (diffuse + specular) * attenuation;
+		}
+	}
+
+	vec4 previous = imageLoad(lColor, pixel);
+	if (heatmap) {
+		// Saturates at 64 lights a tile, overflowing tiles are white
+		vec3 tint = tileLightCount > MAX_TILE_LIGHTS ? vec3(1.0) : heat(min(float(count) / 64.0, 1.0));
+		imageStore(lColor, pixel, vec4(mix(previous.rgb + result, tint, 0.5), 1.0));
+	}
+	else {
+		imageStore(lColor, pixel, vec4(previous.rgb + result, 1.0));
+	}
+}
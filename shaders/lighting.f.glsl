@@ -3,22 +3,25 @@
 out vec4 FragColor; // Output color
 in vec2 vTexCoords; // Location on screen
 
-uniform sampler2D gPosition;   // World space position
-uniform sampler2D gNormal;     // World space normals
+#include "gbuffer.glsl"
+
 uniform sampler2D gAlbedoSpec; // Albedo in rgb spec in a
 uniform sampler2D ssaoInput;
-
-uniform vec3 viewPos; // Viewport position
+uniform bool ssaoEnabled = true; // Off when the SSAO pass was culled, ssaoInput is stale
 
 const vec3 sundir = vec3(1, 1, 0); // Sun Direction
 
 void main() {
+	// Nothing was drawn here, the sky keeps the clear color
+	if (texture(gDepth, vTexCoords).r == 1.0) {
+		discard;
+	}
+
 	// Get data from gbuffer
-	vec3 FragPos = texture(gPosition, vTexCoords).rgb;
-	vec3 Normal  = texture(gNormal, vTexCoords).rgb;
+	vec3 Normal  = gbuffer_normal(vTexCoords);
 	vec3 Albedo  = texture(gAlbedoSpec, vTexCoords).rgb;
 	float Spec   = texture(gAlbedoSpec, vTexCoords).a;
-	float ssao   = texture(ssaoInput, vTexCoords).r;
+	float ssao   = ssaoEnabled ? texture(ssaoInput, vTexCoords).r : 1.0;
 
 	// Calculate lighting
     float in_sun = clamp(dot(Normal, normalize(sundir)) * 3.0, -1, 1) * 0.5 + 0.5;
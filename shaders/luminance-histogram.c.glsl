@@ -0,0 +1,46 @@
+#version 430 core
+
+// Counts lColor's pixels into log2 luminance bins. Bin 0 holds pixels too dark
+// to take the log of, the rest evenly split [minLogLum, minLogLum + logLumRange].
+
+#define BINS 64
+
+layout (local_size_x = 16, local_size_y = 16) in;
+
+uniform sampler2D hdrColor;
+
+layout (std430, binding = 2) buffer Luminance_Histogram {
+	uint bins[BINS];
+};
+
+uniform float minLogLum;
+uniform float logLumRange;
+
+shared uint localBins[BINS];
+
+void main() {
+	uint index = gl_LocalInvocationIndex;
+	if (index < uint(BINS)) {
+		localBins[index] = 0u;
+	}
+	barrier();
+
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	if (all(lessThan(pixel, textureSize(hdrColor, 0)))) {
+		vec3 color = texelFetch(hdrColor, pixel, 0).rgb;
+		float luminance = dot(color, vec3(0.21, 0.71, 0.07));
+
+		uint bin = 0u;
+		if (luminance > 0.0001) {
+			float t = clamp((log2(luminance) - minLogLum) / logLumRange, 0.0, 1.0);
+			bin = 1u + min(uint(t * float(BINS - 1)), uint(BINS - 2));
+		}
+		// Shared atomics first so each bin only takes one global atomic per workgroup
+		atomicAdd(localBins[bin], 1u);
+	}
+	barrier();
+
+	if (index < uint(BINS) && localBins[index] != 0u) {
+		atomicAdd(bins[index], localBins[index]);
+	}
+}
@@ -0,0 +1,34 @@
+#version 330 core
+
+// One direction of a separable Gaussian over reduced resolution SSAO. Taps
+// across a depth discontinuity are weighted down so occlusion doesn't bleed
+// between foreground and background.
+
+out float fragColor;
+
+uniform sampler2D ssaoInput;
+uniform sampler2D ssaoDepth; // Linear view depth
+uniform ivec2 direction;
+
+const int radius = 4;
+const float weights[radius + 1] = float[](0.2270, 0.1946, 0.1216, 0.0541, 0.0162);
+const float depthSharpness = 20.0;
+
+void main() {
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	ivec2 last = textureSize(ssaoInput, 0) - 1;
+	float centerDepth = texelFetch(ssaoDepth, pixel, 0).r;
+
+	float result = 0.0;
+	float total = 0.0;
+	for (int i = -radius; i <= radius; ++i) {
+		ivec2 tap = clamp(pixel + direction * i, ivec2(0), last);
+		float depth = texelFetch(ssaoDepth, tap, 0).r;
+		float weight = weights[abs(i)] * exp(-depthSharpness * abs(depth - centerDepth) / centerDepth);
+
+		result += texelFetch(ssaoInput, tap, 0).r * weight;
+		total += weight;
+	}
+
+	fragColor = result / total;
+}
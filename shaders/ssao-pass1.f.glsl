@@ -1,19 +1,23 @@
 #version 330 core
 
-out float FragColor;
+layout (location = 0) out float FragColor;
+// Linear view depth for the reduced resolution blur and upsample
+layout (location = 1) out float ViewDepth;
 
 in vec2 vTexCoords;
 
-uniform sampler2D gPositionDepth;
-uniform sampler2D gNormal;
-uniform sampler2D gDepth;
+#include "gbuffer.glsl"
+
 uniform sampler2D texNoise;
 
 uniform vec3 samples[64];
-uniform mat4 view;
-uniform mat4 projection;
 
-const int kernelSize = 32;
+// Temporal SSAO takes sampleCount of the kernel's samples a frame, starting
+// at sampleOffset, and leaves the pow to after accumulation
+uniform int sampleOffset = 0;
+uniform int sampleCount = 32;
+uniform bool rawOcclusion = false;
+
 const float radius = 2.0;
 const float bias = 0.000;
 
@@ -26,10 +30,19 @@ float LinearizeDepth(float depth) {
 }
 
 void main() {
+	// Nothing was drawn here, written as the clear color would leave it
+	float rawDepth = texture(gDepth, vTexCoords).r;
+	if (rawDepth == 1.0) {
+		FragColor = 1.0;
+		ViewDepth = FAR;
+		return;
+	}
+
 	// Inputs
-	vec3 fragPos = texture(gPositionDepth, vTexCoords).xyz;
-	vec3 normal = normalize(texture(gNormal, vTexCoords).rgb);
-	float depth = LinearizeDepth(texture(gDepth, vTexCoords).r);
+	vec3 fragPos = gbuffer_position(vTexCoords);
+	vec3 normal = gbuffer_normal(vTexCoords);
+	float depth = LinearizeDepth(rawDepth);
+	ViewDepth = depth;
 
 	vec3 randomVec = texture(texNoise, gl_FragCoord.xy / vec2(4.0)).xyz;
     // vec3 randomVec = vec3(1.0, 0, 0);
@@ -41,7 +54,7 @@ void main() {
 
 	// Iterate over the sample kernel and calculate occlusion factor
     float occlusion = 0.0;
-    for(int i = 0; i < kernelSize; ++i) {
+    for(int i = sampleOffset; i < sampleOffset + sampleCount; ++i) {
         // get sample position
         vec3 sample = TBN * samples[i]; // From tangent to view-spaaaaaace
         sample = fragPos + sample * radius;
@@ -60,8 +73,8 @@ void main() {
         float final = (sampleDepth >= sample.z + bias ? 1.0 : 0.0) * rangeCheck;
         occlusion += final;
     }
-    occlusion = 1.0 - (occlusion / kernelSize);
+    occlusion = 1.0 - (occlusion / sampleCount);
     
-    FragColor = pow(occlusion, 3);
+    FragColor = rawOcclusion ? occlusion : pow(occlusion, 3);
     // FragColor =  bitangent, 1.0;
 }
@@ -0,0 +1,49 @@
+#version 330 core
+
+// Temporal SSAO resolve: blends this frame's few samples of occlusion into
+// last frame's history, found by reprojecting each pixel with the previous
+// view and projection. History whose depth doesn't match is thrown away, so
+// disoccluded pixels start over instead of smearing.
+
+in vec2 vTexCoords;
+
+out vec4 history; // Display occlusion, linear view depth, frames accumulated, linear occlusion
+
+#include "gbuffer.glsl"
+
+uniform sampler2D ssaoInput;      // This frame's linear occlusion
+uniform sampler2D previousHistory;
+
+uniform mat4 reprojection; // This frame's view space to last frame's clip space
+
+const float maxFrames = 32.0;
+const float depthTolerance = 0.05;
+
+void main() {
+	if (texture(gDepth, vTexCoords).r == 1.0) {
+		history = vec4(1.0, 0.0, 0.0, 1.0);
+		return;
+	}
+
+	vec3 fragPos = gbuffer_position(vTexCoords);
+	float current = texture(ssaoInput, vTexCoords).r;
+
+	// Last frame's projection, not this one, so resizing doesn't misplace the history.
+	// With a perspective projection w is the linear view depth.
+	vec4 clip = reprojection * vec4(fragPos, 1.0);
+	vec2 previousUV = clip.xy / clip.w * 0.5 + 0.5;
+	float expectedDepth = clip.w;
+
+	float frames = 0.0;
+	float occlusion = current;
+	if (all(greaterThanEqual(previousUV, vec2(0.0))) && all(lessThanEqual(previousUV, vec2(1.0)))) {
+		vec4 previous = texture(previousHistory, previousUV);
+		if (abs(previous.g - expectedDepth) < depthTolerance * expectedDepth) {
+			// Plain average until maxFrames, then a moving average
+			frames = min(previous.b + 1.0, maxFrames);
+			occlusion = mix(previous.a, current, 1.0 / frames);
+		}
+	}
+
+	history = vec4(pow(occlusion, 3), -fragPos.z, max(frames, 1.0), occlusion);
+}
@@ -0,0 +1,53 @@
+#version 330 core
+
+// Bilateral upsample of reduced resolution SSAO: the four nearest low
+// resolution texels are weighted bilinearly and by how close their depth is
+// to this pixel's, so edges stay sharp at full resolution.
+
+in vec2 vTexCoords;
+
+out float fragColor;
+
+uniform sampler2D ssaoInput;
+uniform sampler2D ssaoDepth; // Linear view depth
+uniform sampler2D gDepth;
+
+const float NEAR = 0.5;
+const float FAR = 1000;
+const float depthSharpness = 20.0;
+
+float LinearizeDepth(float depth) {
+	float z = depth * 2.0 - 1.0; // Back to NDC
+	return (2.0 * NEAR * FAR) / (FAR + NEAR - z * (FAR - NEAR));
+}
+
+void main() {
+	float rawDepth = texture(gDepth, vTexCoords).r;
+	if (rawDepth == 1.0) {
+		fragColor = 1.0;
+		return;
+	}
+	float depth = LinearizeDepth(rawDepth);
+
+	ivec2 size = textureSize(ssaoInput, 0);
+	vec2 position = vTexCoords * vec2(size) - 0.5;
+	ivec2 base = ivec2(floor(position));
+	vec2 f = position - floor(position);
+
+	float result = 0.0;
+	float total = 0.0;
+	for (int y = 0; y <= 1; ++y) {
+		for (int x = 0; x <= 1; ++x) {
+			ivec2 tap = clamp(base + ivec2(x, y), ivec2(0), size - 1);
+			float bilinear = (x == 1 ? f.x : 1.0 - f.x) * (y == 1 ? f.y : 1.0 - f.y);
+			float tapDepth = texelFetch(ssaoDepth, tap, 0).r;
+			// The small floor keeps a pixel unlike all four taps from dividing by zero
+			float weight = bilinear * exp(-depthSharpness * abs(tapDepth - depth) / depth) + 1e-4;
+
+			result += texelFetch(ssaoInput, tap, 0).r * weight;
+			total += weight;
+		}
+	}
+
+	fragColor = result / total;
+}
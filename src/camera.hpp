@@ -24,6 +24,9 @@ class Camera {
 	const glm::vec3& get_up_vec();
 	const glm::vec3& get_right_vec();
 	const glm::mat4& get_matrix();
+	// Projection times view as they were at the last end_frame(), for reprojecting last frame's results
+	const glm::mat4& get_previous_view_projection();
+	void end_frame(const glm::mat4& projection);
 
   private:
 	void recalculate_view_matrix();
@@ -33,6 +36,7 @@ class Camera {
 
 	float speed = 1.0f;
 	glm::mat4 view;
+	glm::mat4 previous_view_projection;
 
 	glm::vec3 position;
 	glm::vec3 direction;
@@ -60,3 +60,9 @@ inline const glm::vec3& Camera::get_right_vec() {
 inline const glm::mat4& Camera::get_matrix() {
 	return view;
 }
+inline const glm::mat4& Camera::get_previous_view_projection() {
+	return previous_view_projection;
+}
+inline void Camera::end_frame(const glm::mat4& projection) {
+	previous_view_projection = projection * view;
+}
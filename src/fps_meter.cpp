@@ -1,14 +1,48 @@
 #include "fps_meter.hpp"
-#include <SDL2/SDL.h>
 #include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <utility>
 
+constexpr std::size_t FPS_Meter::capacity;
+constexpr float FPS_Meter::stutter_factor;
+constexpr std::size_t FPS_Meter::bins;
+constexpr float FPS_Meter::bin_limits[FPS_Meter::bins - 1];
+
+FPS_Meter::FPS_Meter(bool print, float purge) : print_fps(print), purge_rate(purge), start(Clock::now()) {}
+
 void FPS_Meter::frame(size_t lightcount) {
-	last_frame_time = std::exchange(frame_time, SDL_GetTicks() / 1000.f);
-	frame_times.push_back(frame_time);
+	last_frame_time = std::exchange(frame_time, std::chrono::duration<double>(Clock::now() - start).count());
+	float ms        = static_cast<float>((frame_time - last_frame_time) * 1000);
+
+	// Needs a few frames of history before anything counts as slow
+	bool stutter = count >= 10 && ms > stutter_factor * window_ms / count;
+
+	auto drop_oldest = [&] {
+		window_ms -= frame_ms[first];
+		stutters -= stuttered[first];
+		first = (first + 1) % capacity;
+		count -= 1;
+	};
+
+	if (count == capacity) {
+		drop_oldest();
+	}
+	std::size_t slot = (first + count) % capacity;
+	frame_ms[slot]   = ms;
+	stuttered[slot]  = stutter;
+	count += 1;
+	window_ms += ms;
+	stutters += stutter;
+	total_stutters += stutter;
+
+	while (count > 1 && window_ms - frame_ms[first] >= purge_rate * 1000) {
+		drop_oldest();
+	}
+
 	frame_number += 1;
 	fps_ready = false;
+	printed_frame = false;
 	update_fps(lightcount);
 }
 
@@ -22,37 +56,83 @@ uint64_t FPS_Meter::get_frame_number() {
 }
 
 float FPS_Meter::get_time() {
-	return frame_time;
+	return static_cast<float>(frame_time);
 }
 
 float FPS_Meter::get_delta_time() {
-	return frame_time - last_frame_time;
+	return static_cast<float>(frame_time - last_frame_time);
+}
+
+bool FPS_Meter::printed() {
+	return printed_frame;
+}
+
+FPS_Meter::Frame_Stats FPS_Meter::get_stats() {
+	Frame_Stats stats{0, 0, 0, 0, count, stutters};
+	if (count == 0) {
+		return stats;
+	}
+
+	for (std::size_t i = 0; i < count; ++i) {
+		scratch[i] = frame_ms[(first + i) % capacity];
+	}
+	auto percentile = [&](float p) {
+		auto nth = scratch.begin() + static_cast<std::size_t>(std::ceil(p * count)) - 1;
+		std::nth_element(scratch.begin(), nth, scratch.begin() + count);
+		return *nth;
+	};
+	stats.p50 = percentile(0.50f);
+	stats.p95 = percentile(0.95f);
+	stats.p99 = percentile(0.99f);
+	stats.max = *std::max_element(scratch.begin(), scratch.begin() + count);
+	return stats;
+}
+
+std::array<std::size_t, FPS_Meter::bins> FPS_Meter::get_histogram() {
+	std::array<std::size_t, bins> histogram{};
+	for (std::size_t i = 0; i < count; ++i) {
+		float ms = frame_ms[(first + i) % capacity];
+		histogram[std::upper_bound(std::begin(bin_limits), std::end(bin_limits), ms) - std::begin(bin_limits)] += 1;
+	}
+	return histogram;
+}
+
+uint64_t FPS_Meter::get_total_stutters() {
+	return total_stutters;
 }
 
 void FPS_Meter::update_fps(size_t lightcount) {
 	auto calc_fps = [&]() {
-		fps = static_cast<float>(frame_times.size()) / (frame_times.back() - frame_times.front());
+		fps = window_ms > 0 ? static_cast<float>(count * 1000 / window_ms) : 0;
 		timeperlight = ((1.0 / fps) * 1000) / lightcount;
 	};
 
 	auto print = [&]() {
 		if (print_fps && frame_time - last_print_time >= 1) {
-			std::cout << "FPS: " << fps << " - " << frame_times.size() << " - " << timeperlight << "ms/light" << std::endl;
+			Frame_Stats stats = get_stats();
+			std::cout << "FPS: " << fps << " - " << count << " - " << timeperlight << "ms/light - p50/p95/p99/max "
+			          << stats.p50 << '/' << stats.p95 << '/' << stats.p99 << '/' << stats.max << "ms - " << stats.stutters
+			          << " stutters\n";
+
+			auto histogram = get_histogram();
+			std::cout << "Frame times:";
+			for (std::size_t i = 0; i < bins; ++i) {
+				if (i + 1 < bins) {
+					std::cout << " <" << bin_limits[i] << "ms " << histogram[i];
+				}
+				else {
+					std::cout << " >=" << bin_limits[i - 1] << "ms " << histogram[i];
+				}
+			}
+			std::cout << std::endl;
+
 			last_print_time = frame_time;
+			printed_frame = true;
 		}
 	};
 
 	if (fps_ready == false) {
-		if (frame_times.size() > 10) {
-			float front_time = frame_times.back();
-			auto new_end     = std::remove_if(frame_times.begin(), frame_times.end(),
-			                              [&front_time, this](float val) { return front_time - val > purge_rate; });
-			frame_times.erase(new_end, frame_times.end());
-
-			calc_fps();
-			print();
-		}
-		else if (frame_times.size() != 0) {
+		if (count != 0) {
 			calc_fps();
 			print();
 		}
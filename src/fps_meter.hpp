@@ -1,32 +1,71 @@
 #pragma once
 
+#include <array>
+#include <chrono>
 #include <cinttypes>
-#include <vector>
+#include <cstddef>
 
+// Frame rate and frame time statistics over the last purge seconds.
+//
+// Frame times live in a fixed ring, so frame() never allocates. Frames
+// taking more than stutter_factor times the window's average count as
+// stutters.
 class FPS_Meter {
   public:
-	FPS_Meter(bool print = false, float purge = 1) : print_fps(print), purge_rate(purge){};
+	static constexpr std::size_t capacity = 1024;
+	static constexpr float stutter_factor = 2.0f;
+	// Upper bounds in ms of each histogram bin, the last bin takes everything slower
+	static constexpr std::size_t bins           = 8;
+	static constexpr float bin_limits[bins - 1] = {4.0f, 8.0f, 16.7f, 33.3f, 50.0f, 100.0f, 250.0f};
+
+	struct Frame_Stats {
+		float p50, p95, p99, max; // ms
+		std::size_t frames;
+		std::size_t stutters;
+	};
+
+	FPS_Meter(bool print = false, float purge = 1);
 	void frame(std::size_t lightcount);
 	float get_fps(std::size_t lightcount);
 	uint64_t get_frame_number();
 	float get_time();
 	float get_delta_time();
+	// Whether the last frame() printed, so other stats can report on the same cadence
+	bool printed();
+
+	Frame_Stats get_stats();
+	std::array<std::size_t, bins> get_histogram();
+	// Every stutter since the meter started
+	uint64_t get_total_stutters();
 
   private:
+	using Clock = std::chrono::steady_clock;
+
 	void update_fps(std::size_t light_count);
 
 	bool print_fps;
+	bool printed_frame = false;
+
+	// Oldest frame at first, count frames long
+	std::array<float, capacity> frame_ms;
+	std::array<bool, capacity> stuttered;
+	std::array<float, capacity> scratch; // Sorted copy for percentiles
+	std::size_t first       = 0;
+	std::size_t count       = 0;
+	double window_ms        = 0;
+	std::size_t stutters    = 0; // In the window
+	uint64_t total_stutters = 0;
 
-	std::vector<float> frame_times;
-	bool fps_ready   = false;
-	float fps        = 0;
+	bool fps_ready     = false;
+	float fps          = 0;
 	float timeperlight = 0;
-	float purge_rate = 1;
+	float purge_rate   = 1;
 
 	uint64_t frame_number = 0;
 
-	float frame_time      = 0;
-	float last_frame_time = 0;
+	Clock::time_point start;
+	double frame_time      = 0; // Seconds since start
+	double last_frame_time = 0;
 
-	float last_print_time = 0;
+	double last_print_time = 0;
 };
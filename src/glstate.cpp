@@ -0,0 +1,200 @@
+#include "glstate.hpp"
+
+#include <iostream>
+
+namespace {
+	// Index into GL_State::caps, or -1 for caps that aren't cached
+	int cap_index(GLenum cap) {
+		switch (cap) {
+			case GL_BLEND:
+				return 0;
+			case GL_CULL_FACE:
+				return 1;
+			case GL_DEPTH_TEST:
+				return 2;
+			case GL_STENCIL_TEST:
+				return 3;
+			default:
+				return -1;
+		}
+	}
+} // namespace
+
+void GL_State::use_program(GLuint p) {
+	if (change(program, p)) {
+		glUseProgram(p);
+	}
+}
+
+void GL_State::bind_vertex_array(GLuint v) {
+	if (change(vao, v)) {
+		glBindVertexArray(v);
+		element_buffer.known = false;
+	}
+}
+
+void GL_State::bind_buffer(GLenum target, GLuint buffer) {
+	Cached<GLuint>* cached = nullptr;
+	if (target == GL_ARRAY_BUFFER) {
+		cached = &array_buffer;
+	}
+	else if (target == GL_ELEMENT_ARRAY_BUFFER) {
+		cached = &element_buffer;
+	}
+
+	if (!cached) {
+		current.issued += 1;
+		glBindBuffer(target, buffer);
+	}
+	else if (change(*cached, buffer)) {
+		glBindBuffer(target, buffer);
+	}
+}
+
+void GL_State::bind_framebuffer(GLuint f) {
+	if (change(framebuffer, f)) {
+		glBindFramebuffer(GL_FRAMEBUFFER, f);
+	}
+}
+
+void GL_State::bind_texture(GLuint unit, GLenum target, GLuint texture) {
+	if (change(active_texture, unit)) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+	if (unit >= textures.size()) {
+		textures.resize(unit + 1);
+	}
+	if (change(textures[unit], std::make_tuple(target, texture))) {
+		glBindTexture(target, texture);
+	}
+}
+
+void GL_State::set_cap(GLenum cap, bool enabled) {
+	int index = cap_index(cap);
+	if (index < 0) {
+		current.issued += 1;
+	}
+	else if (!change(caps[index], enabled)) {
+		return;
+	}
+
+	if (enabled) {
+		glEnable(cap);
+	}
+	else {
+		glDisable(cap);
+	}
+}
+
+void GL_State::enable(GLenum cap) {
+	set_cap(cap, true);
+}
+
+void GL_State::disable(GLenum cap) {
+	set_cap(cap, false);
+}
+
+void GL_State::blend_func(GLenum source, GLenum destination) {
+	if (change(blend, std::make_tuple(source, destination))) {
+		glBlendFunc(source, destination);
+	}
+}
+
+void GL_State::color_mask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha) {
+	if (change(colors, std::make_tuple(red, green, blue, alpha))) {
+		glColorMask(red, green, blue, alpha);
+	}
+}
+
+void GL_State::cull_face(GLenum face) {
+	if (change(cull, face)) {
+		glCullFace(face);
+	}
+}
+
+void GL_State::depth_func(GLenum func) {
+	if (change(depth, func)) {
+		glDepthFunc(func);
+	}
+}
+
+void GL_State::depth_mask(GLboolean flag) {
+	if (change(depth_write, flag)) {
+		glDepthMask(flag);
+	}
+}
+
+void GL_State::stencil_func(GLenum func, GLint ref, GLuint mask) {
+	if (change(stencil, std::make_tuple(func, ref, mask))) {
+		glStencilFunc(func, ref, mask);
+	}
+}
+
+void GL_State::stencil_mask(GLuint mask) {
+	if (change(stencil_write, mask)) {
+		glStencilMask(mask);
+	}
+}
+
+void GL_State::stencil_op(GLenum stencil_fail, GLenum depth_fail, GLenum depth_pass) {
+	if (change(stencil_ops, std::make_tuple(stencil_fail, depth_fail, depth_pass))) {
+		glStencilOp(stencil_fail, depth_fail, depth_pass);
+	}
+}
+
+void GL_State::clear_color(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) {
+	if (change(clear, std::make_tuple(red, green, blue, alpha))) {
+		glClearColor(red, green, blue, alpha);
+	}
+}
+
+void GL_State::viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+	if (change(view, std::make_tuple(x, y, width, height))) {
+		glViewport(x, y, width, height);
+	}
+}
+
+void GL_State::invalidate() {
+	program.known        = false;
+	vao.known            = false;
+	framebuffer.known    = false;
+	active_texture.known = false;
+	textures.clear();
+	for (auto& cap : caps) {
+		cap.known = false;
+	}
+	blend.known         = false;
+	colors.known        = false;
+	cull.known          = false;
+	depth.known         = false;
+	depth_write.known   = false;
+	stencil.known       = false;
+	stencil_write.known = false;
+	stencil_ops.known   = false;
+	clear.known         = false;
+	view.known          = false;
+	invalidate_buffers();
+}
+
+void GL_State::invalidate_buffers() {
+	array_buffer.known   = false;
+	element_buffer.known = false;
+}
+
+void GL_State::invalidate_framebuffer() {
+	framebuffer.known = false;
+}
+
+void GL_State::end_frame() {
+	last_frame = current;
+	current    = Counters{};
+}
+
+void GL_State::print(std::ostream& out) const {
+	std::uint64_t total = last_frame.issued + last_frame.elided;
+	out << "GL state calls: " << last_frame.issued << " issued, " << last_frame.elided << " elided";
+	if (total) {
+		out << " (" << last_frame.elided * 100 / total << "%)";
+	}
+	out << '\n';
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <tuple>
+#include <vector>
+
+// Shadow copy of the GL state the render loop touches.
+//
+// Every setter compares against what it last set and drops the call when
+// nothing would change. State starts out unknown, so the first call of each
+// kind always goes through, and invalidate() forgets everything after code
+// outside the cache (buffer setup, the render target pool, Stream_Buffer
+// maps) has changed bindings. The element buffer binding belongs to the
+// VAO, so it's forgotten whenever the VAO changes. Counts of calls issued
+// and elided are kept per frame.
+class GL_State {
+  public:
+	struct Counters {
+		std::uint64_t issued = 0;
+		std::uint64_t elided = 0;
+	};
+
+	GL_State() = default;
+	GL_State(const GL_State&) = delete;
+	GL_State& operator=(const GL_State&) = delete;
+
+	void use_program(GLuint program);
+	void bind_vertex_array(GLuint vao);
+	// Only GL_ARRAY_BUFFER and GL_ELEMENT_ARRAY_BUFFER are cached, other targets always go through.
+	void bind_buffer(GLenum target, GLuint buffer);
+	// Both read and draw.
+	void bind_framebuffer(GLuint framebuffer);
+	// Makes unit active, so calls that act on the bound texture work after it.
+	void bind_texture(GLuint unit, GLenum target, GLuint texture);
+
+	// Blend, cull face, depth and stencil test are cached, other caps always go through.
+	void enable(GLenum cap);
+	void disable(GLenum cap);
+
+	void blend_func(GLenum source, GLenum destination);
+	void color_mask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha);
+	void cull_face(GLenum face);
+	void depth_func(GLenum func);
+	void depth_mask(GLboolean flag);
+	void stencil_func(GLenum func, GLint ref, GLuint mask);
+	void stencil_mask(GLuint mask);
+	void stencil_op(GLenum stencil_fail, GLenum depth_fail, GLenum depth_pass);
+
+	void clear_color(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+	void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	void invalidate();
+	void invalidate_buffers();
+	void invalidate_framebuffer();
+
+	// Starts counting the next frame.
+	void end_frame();
+
+	// The last finished frame.
+	const Counters& get_counters() const {
+		return last_frame;
+	}
+	void print(std::ostream& out) const;
+
+  private:
+	template <class T>
+	struct Cached {
+		T value;
+		bool known = false;
+	};
+
+	// True if value differs from what's cached, which then becomes value.
+	template <class T>
+	bool change(Cached<T>& cached, const T& value) {
+		if (cached.known && cached.value == value) {
+			current.elided += 1;
+			return false;
+		}
+		cached.value = value;
+		cached.known = true;
+		current.issued += 1;
+		return true;
+	}
+
+	void set_cap(GLenum cap, bool enabled);
+
+	Cached<GLuint> program, vao, array_buffer, element_buffer, framebuffer;
+	Cached<GLuint> active_texture;
+	std::vector<Cached<std::tuple<GLenum, GLuint>>> textures; // Per unit, grown as units are used
+
+	std::array<Cached<bool>, 4> caps;
+
+	Cached<std::tuple<GLenum, GLenum>> blend;
+	Cached<std::tuple<GLboolean, GLboolean, GLboolean, GLboolean>> colors;
+	Cached<GLenum> cull;
+	Cached<GLenum> depth;
+	Cached<GLboolean> depth_write;
+	Cached<std::tuple<GLenum, GLint, GLuint>> stencil;
+	Cached<GLuint> stencil_write;
+	Cached<std::tuple<GLenum, GLenum, GLenum>> stencil_ops;
+
+	Cached<std::tuple<GLfloat, GLfloat, GLfloat, GLfloat>> clear;
+	Cached<std::tuple<GLint, GLint, GLsizei, GLsizei>> view;
+
+	Counters current, last_frame;
+};
@@ -0,0 +1,114 @@
+#include "jobsystem.hpp"
+
+#include <algorithm>
+
+Job_System::Job_System(std::size_t threads) {
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	for (std::size_t i = 0; i < threads; ++i) {
+		queues.emplace_back(new Queue);
+	}
+
+	workers.reserve(threads - 1);
+	for (std::size_t i = 1; i < threads; ++i) {
+		workers.emplace_back(&Job_System::worker, this, i);
+	}
+}
+
+Job_System::~Job_System() {
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		quit = true;
+	}
+	wake.notify_all();
+
+	for (auto& t : workers) {
+		t.join();
+	}
+}
+
+void Job_System::parallel_for(std::size_t count, std::size_t batch_size, const Range_Func& func) {
+	if (count == 0) {
+		return;
+	}
+	batch_size = std::max<std::size_t>(batch_size, 1);
+
+	std::size_t batches = (count + batch_size - 1) / batch_size;
+	if (batches == 1 || queues.size() == 1) {
+		func(0, count);
+		return;
+	}
+
+	std::atomic<std::size_t> remaining(batches);
+
+	// Deal batches out round robin so every thread starts with local work
+	for (std::size_t b = 0; b < batches; ++b) {
+		Queue& q = *queues[b % queues.size()];
+		std::lock_guard<std::mutex> lock(q.mutex);
+		q.jobs.push_back(Job{&func, b * batch_size, std::min(count, (b + 1) * batch_size), &remaining});
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		queued += batches;
+	}
+	wake.notify_all();
+
+	while (remaining.load(std::memory_order_acquire) != 0) {
+		if (!try_run(0)) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+bool Job_System::pop(std::size_t index, Job& job) {
+	{
+		Queue& own = *queues[index];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.jobs.empty()) {
+			job = own.jobs.back();
+			own.jobs.pop_back();
+			return true;
+		}
+	}
+
+	for (std::size_t i = 1; i < queues.size(); ++i) {
+		Queue& victim = *queues[(index + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.jobs.empty()) {
+			job = victim.jobs.front();
+			victim.jobs.pop_front();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool Job_System::try_run(std::size_t index) {
+	Job job;
+	if (!pop(index, job)) {
+		return false;
+	}
+	queued.fetch_sub(1, std::memory_order_relaxed);
+
+	(*job.func)(job.begin, job.end);
+	job.remaining->fetch_sub(1, std::memory_order_release);
+	return true;
+}
+
+void Job_System::worker(std::size_t index) {
+	while (true) {
+		if (try_run(index)) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		wake.wait(lock, [this] { return quit || queued.load(std::memory_order_relaxed) != 0; });
+		if (quit) {
+			return;
+		}
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads with per-thread work-stealing queues.
+//
+// The thread that calls parallel_for takes part in the work and returns once
+// every batch has run. Workers pop their own queue newest first and steal the
+// oldest job from the others when they run dry. parallel_for must only be
+// called from one thread at a time.
+class Job_System {
+  public:
+	using Range_Func = std::function<void(std::size_t begin, std::size_t end)>;
+
+	// threads counts the calling thread, 0 means one per core.
+	explicit Job_System(std::size_t threads = 0);
+	Job_System(const Job_System&) = delete;
+	Job_System& operator=(const Job_System&) = delete;
+	~Job_System();
+
+	std::size_t thread_count() const {
+		return queues.size();
+	}
+
+	// Runs func over [0, count) split into batches of at most batch_size and waits for all of them.
+	void parallel_for(std::size_t count, std::size_t batch_size, const Range_Func& func);
+
+  private:
+	struct Job {
+		const Range_Func* func;
+		std::size_t begin;
+		std::size_t end;
+		std::atomic<std::size_t>* remaining;
+	};
+
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	bool pop(std::size_t index, Job& job);
+	bool try_run(std::size_t index);
+	void worker(std::size_t index);
+
+	// Index 0 belongs to the thread calling parallel_for
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+
+	std::mutex sleep_mutex;
+	std::condition_variable wake;
+	std::atomic<std::size_t> queued{0};
+	bool quit = false;
+};
@@ -0,0 +1,124 @@
+#include "lightclusters.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// Lights per batch when computing bounds on the job system
+	constexpr std::size_t bounds_batch_size = 4096;
+} // namespace
+
+constexpr std::size_t Light_Clusters::tile_size;
+constexpr std::size_t Light_Clusters::depth_slices;
+
+void Light_Clusters::build(const glm::vec4* view_positions, std::size_t count, const glm::mat4& projection, float z_near,
+                           float z_far, std::size_t width, std::size_t height, Job_System* jobs) {
+	tiles = Tile_Projection(projection, z_near, width, height, tile_size);
+
+	slice_scale = depth_slices / std::log2(z_far / z_near);
+	slice_bias  = -std::log2(z_near) * slice_scale;
+
+	min_x.resize(count);
+	max_x.resize(count);
+	min_y.resize(count);
+	max_y.resize(count);
+	min_z.resize(count);
+	max_z.resize(count);
+
+	clusters.assign(tiles.tiles_x * tiles.tiles_y * depth_slices, glm::uvec2(0));
+	cursors.resize(clusters.size());
+
+	// Every slice is independent, so the counting and filling passes split by slice.
+	// Each pass scans all lights, which keeps the output in light order without any merging.
+	if (jobs) {
+		jobs->parallel_for(count, bounds_batch_size,
+		                   [&](std::size_t begin, std::size_t end) { compute_bounds(view_positions, begin, end); });
+		jobs->parallel_for(depth_slices, 1, [&](std::size_t begin, std::size_t end) {
+			for (std::size_t s = begin; s < end; ++s) {
+				count_slice(s, count);
+			}
+		});
+	}
+	else {
+		compute_bounds(view_positions, 0, count);
+		for (std::size_t s = 0; s < depth_slices; ++s) {
+			count_slice(s, count);
+		}
+	}
+
+	std::uint32_t offset = 0;
+	for (std::size_t c = 0; c < clusters.size(); ++c) {
+		clusters[c].x = offset;
+		cursors[c]    = offset;
+		offset += clusters[c].y;
+	}
+	indices.resize(offset);
+
+	if (jobs) {
+		jobs->parallel_for(depth_slices, 1, [&](std::size_t begin, std::size_t end) {
+			for (std::size_t s = begin; s < end; ++s) {
+				fill_slice(s, count);
+			}
+		});
+	}
+	else {
+		for (std::size_t s = 0; s < depth_slices; ++s) {
+			fill_slice(s, count);
+		}
+	}
+}
+
+void Light_Clusters::compute_bounds(const glm::vec4* view_positions, std::size_t begin, std::size_t end) {
+	const std::int32_t gz = static_cast<std::int32_t>(depth_slices);
+
+	for (std::size_t i = begin; i < end; ++i) {
+		glm::vec4 l  = view_positions[i];
+		float r      = l.w;
+		float d_near = -l.z - r;
+		float d_far  = -l.z + r;
+
+		// Lights entirely behind the near plane end up with max_z < 0, past far with min_z >= depth_slices
+		float s0 = std::log2(std::max(d_near, tiles.z_near)) * slice_scale + slice_bias;
+		float s1 = std::log2(std::max(d_far, 1e-6f)) * slice_scale + slice_bias;
+		min_z[i] = std::max(grid_cell(s0, gz), 0);
+		max_z[i] = std::min(grid_cell(s1, gz), gz - 1);
+
+		Tile_Range range = sphere_tiles(tiles, l);
+		min_x[i]         = range.min_x;
+		max_x[i]         = range.max_x;
+		min_y[i]         = range.min_y;
+		max_y[i]         = range.max_y;
+	}
+}
+
+void Light_Clusters::count_slice(std::size_t slice, std::size_t count) {
+	const std::int32_t s = static_cast<std::int32_t>(slice);
+	glm::uvec2* slice_clusters = clusters.data() + slice * tiles.tiles_x * tiles.tiles_y;
+
+	for (std::size_t i = 0; i < count; ++i) {
+		if (min_z[i] > s || max_z[i] < s) {
+			continue;
+		}
+		for (std::int32_t y = min_y[i]; y <= max_y[i]; ++y) {
+			for (std::int32_t x = min_x[i]; x <= max_x[i]; ++x) {
+				++slice_clusters[y * tiles.tiles_x + x].y;
+			}
+		}
+	}
+}
+
+void Light_Clusters::fill_slice(std::size_t slice, std::size_t count) {
+	const std::int32_t s = static_cast<std::int32_t>(slice);
+	std::uint32_t* slice_cursors = cursors.data() + slice * tiles.tiles_x * tiles.tiles_y;
+
+	for (std::size_t i = 0; i < count; ++i) {
+		if (min_z[i] > s || max_z[i] < s) {
+			continue;
+		}
+		for (std::int32_t y = min_y[i]; y <= max_y[i]; ++y) {
+			for (std::int32_t x = min_x[i]; x <= max_x[i]; ++x) {
+				indices[slice_cursors[y * tiles.tiles_x + x]++] = static_cast<std::uint32_t>(i);
+			}
+		}
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "jobsystem.hpp"
+#include "lightculling.hpp"
+#include "util.hpp"
+
+// CPU light assignment for clustered forward shading.
+//
+// The view frustum is cut into tile_size pixel screen tiles and depth_slices
+// exponentially spaced depth slices. build() gives every cluster an (offset,
+// count) range into one packed list of light indices. Clusters are ordered x
+// fastest, then y, then slice, and each cluster's lights are in ascending
+// order no matter how many threads did the work.
+class Light_Clusters {
+  public:
+	static constexpr std::size_t tile_size    = 64;
+	static constexpr std::size_t depth_slices = 24;
+
+	// view_positions are view space position and radius, as written by Light_System::update.
+	// projection must be a symmetric perspective like glm::perspective makes, z_near and z_far its clip planes.
+	void build(const glm::vec4* view_positions, std::size_t count, const glm::mat4& projection, float z_near, float z_far,
+	           std::size_t width, std::size_t height, Job_System* jobs = nullptr);
+
+	std::size_t grid_width() const {
+		return tiles.tiles_x;
+	}
+	std::size_t grid_height() const {
+		return tiles.tiles_y;
+	}
+	std::size_t cluster_count() const {
+		return clusters.size();
+	}
+
+	// Offset into get_indices() and light count for each cluster.
+	const std::vector<glm::uvec2>& get_clusters() const {
+		return clusters;
+	}
+	const std::vector<std::uint32_t>& get_indices() const {
+		return indices;
+	}
+
+	// A view space depth d falls in slice floor(log2(d) * slice_scale + slice_bias).
+	float get_slice_scale() const {
+		return slice_scale;
+	}
+	float get_slice_bias() const {
+		return slice_bias;
+	}
+
+  private:
+	using Int_Array = std::vector<std::int32_t, Aligned_Allocator<std::int32_t>>;
+
+	void compute_bounds(const glm::vec4* view_positions, std::size_t begin, std::size_t end);
+	void count_slice(std::size_t slice, std::size_t count);
+	void fill_slice(std::size_t slice, std::size_t count);
+
+	// Inclusive cluster range each light touches, SoA so the per-slice scans vectorize
+	Int_Array min_x, max_x;
+	Int_Array min_y, max_y;
+	Int_Array min_z, max_z;
+
+	std::vector<glm::uvec2> clusters;
+	std::vector<std::uint32_t> indices;
+	std::vector<std::uint32_t> cursors; // Next free index per cluster while filling
+
+	Tile_Projection tiles;
+	float slice_scale = 0;
+	float slice_bias  = 0;
+};
@@ -0,0 +1,201 @@
+#include "lightculling.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	Plane normalize_plane(const Plane& p) {
+		float length = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+		return Plane(p.x / length, p.y / length, p.z / length, p.w / length);
+	}
+
+	// Plane through the eye containing the screen edge at ndc, for x (scale = projection[0][0]) or y
+	glm::vec2 edge_plane(float scale, float ndc) {
+		float length = std::sqrt(scale * scale + ndc * ndc);
+		return glm::vec2(scale / length, ndc / length);
+	}
+
+	// Lights per batch for the frustum test on the job system
+	constexpr std::size_t cull_batch_size = 4096;
+} // namespace
+
+Frustum make_frustum(const glm::mat4& m) {
+	// Gribb and Hartmann: each clip plane is the last row plus or minus another row
+	auto row = [&](int r) { return Plane(m[0][r], m[1][r], m[2][r], m[3][r]); };
+	auto add = [](const Plane& a, const Plane& b) { return Plane(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w); };
+	auto sub = [](const Plane& a, const Plane& b) { return Plane(a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w); };
+
+	Frustum f;
+	f.planes[0] = normalize_plane(add(row(3), row(0)));
+	f.planes[1] = normalize_plane(sub(row(3), row(0)));
+	f.planes[2] = normalize_plane(add(row(3), row(1)));
+	f.planes[3] = normalize_plane(sub(row(3), row(1)));
+	f.planes[4] = normalize_plane(add(row(3), row(2)));
+	f.planes[5] = normalize_plane(sub(row(3), row(2)));
+	return f;
+}
+
+bool sphere_in_frustum(const Frustum& frustum, const glm::vec4& s) {
+	bool in = true;
+	for (auto& p : frustum.planes) {
+		in &= p.x * s.x + p.y * s.y + p.z * s.z + p.w >= -s.w;
+	}
+	return in;
+}
+
+Tile_Projection::Tile_Projection(const glm::mat4& projection, float z_near, std::size_t width, std::size_t height,
+                                 std::size_t tile_size)
+    : tiles_x(static_cast<std::int32_t>(std::max<std::size_t>(1, (width + tile_size - 1) / tile_size))),
+      tiles_y(static_cast<std::int32_t>(std::max<std::size_t>(1, (height + tile_size - 1) / tile_size))),
+      proj_x(projection[0][0]),
+      proj_y(projection[1][1]),
+      z_near(z_near),
+      tile_scale_x(0.5f * width / tile_size),
+      tile_scale_y(0.5f * height / tile_size) {}
+
+std::int32_t grid_cell(float x, std::int32_t limit) {
+	return static_cast<std::int32_t>(std::floor(std::min(std::max(x, -1.0f), static_cast<float>(limit))));
+}
+
+Tile_Range sphere_tiles(const Tile_Projection& t, const glm::vec4& l) {
+	float r      = l.w;
+	float d_near = -l.z - r;
+	float d_far  = -l.z + r;
+
+	if (d_near < t.z_near) {
+		// Straddles the eye plane, no finite screen bounds
+		return Tile_Range{0, t.tiles_x - 1, 0, t.tiles_y - 1};
+	}
+
+	// x / d is smallest at the nearest depth when negative and the farthest when positive,
+	// and the other way around for the maximum.
+	float x0 = l.x - r, x1 = l.x + r;
+	float y0 = l.y - r, y1 = l.y + r;
+	float ndc_x0 = t.proj_x * (x0 < 0 ? x0 / d_near : x0 / d_far);
+	float ndc_x1 = t.proj_x * (x1 > 0 ? x1 / d_near : x1 / d_far);
+	float ndc_y0 = t.proj_y * (y0 < 0 ? y0 / d_near : y0 / d_far);
+	float ndc_y1 = t.proj_y * (y1 > 0 ? y1 / d_near : y1 / d_far);
+
+	Tile_Range range;
+	range.min_x = std::max(grid_cell(ndc_x0 * t.tile_scale_x + t.tile_scale_x, t.tiles_x), 0);
+	range.max_x = std::min(grid_cell(ndc_x1 * t.tile_scale_x + t.tile_scale_x, t.tiles_x), t.tiles_x - 1);
+	range.min_y = std::max(grid_cell(ndc_y0 * t.tile_scale_y + t.tile_scale_y, t.tiles_y), 0);
+	range.max_y = std::min(grid_cell(ndc_y1 * t.tile_scale_y + t.tile_scale_y, t.tiles_y), t.tiles_y - 1);
+	return range;
+}
+
+void Light_Tiles::build(const glm::vec4* view_positions, std::size_t count, const glm::mat4& projection, float z_near,
+                        std::size_t width, std::size_t height, std::size_t tile_size, Job_System* jobs) {
+	tiles   = Tile_Projection(projection, z_near, width, height, tile_size);
+	frustum = make_frustum(projection);
+
+	column_planes.resize(tiles.tiles_x + 1);
+	for (std::int32_t x = 0; x <= tiles.tiles_x; ++x) {
+		float ndc        = 2.0f * std::min(x * tile_size, width) / width - 1.0f;
+		column_planes[x] = edge_plane(tiles.proj_x, ndc);
+	}
+	row_planes.resize(tiles.tiles_y + 1);
+	for (std::int32_t y = 0; y <= tiles.tiles_y; ++y) {
+		float ndc     = 2.0f * std::min(y * tile_size, height) / height - 1.0f;
+		row_planes[y] = edge_plane(tiles.proj_y, ndc);
+	}
+
+	inside.resize(count);
+	min_x.resize(count);
+	max_x.resize(count);
+	min_y.resize(count);
+	max_y.resize(count);
+
+	if (jobs) {
+		jobs->parallel_for(count, cull_batch_size,
+		                   [&](std::size_t begin, std::size_t end) { cull(view_positions, begin, end); });
+	}
+	else {
+		cull(view_positions, 0, count);
+	}
+
+	visible.clear();
+	for (std::size_t i = 0; i < count; ++i) {
+		if (inside[i]) {
+			visible.push_back(static_cast<std::uint32_t>(i));
+		}
+	}
+
+	// Rows are independent, so counting and filling split by row. Each pass scans
+	// every visible light, which keeps the output in light order without merging.
+	tile_lists.assign(tiles.tiles_x * tiles.tiles_y, glm::uvec2(0));
+	cursors.resize(tile_lists.size());
+
+	auto count_rows = [&](std::size_t begin, std::size_t end) {
+		for (std::size_t y = begin; y < end; ++y) {
+			glm::uvec2* row = tile_lists.data() + y * tiles.tiles_x;
+			scan_row(static_cast<std::int32_t>(y), view_positions, [&](std::int32_t x, std::uint32_t) { ++row[x].y; });
+		}
+	};
+	auto fill_rows = [&](std::size_t begin, std::size_t end) {
+		for (std::size_t y = begin; y < end; ++y) {
+			std::uint32_t* row = cursors.data() + y * tiles.tiles_x;
+			scan_row(static_cast<std::int32_t>(y), view_positions,
+			         [&](std::int32_t x, std::uint32_t light) { indices[row[x]++] = light; });
+		}
+	};
+
+	if (jobs) {
+		jobs->parallel_for(tiles.tiles_y, 1, count_rows);
+	}
+	else {
+		count_rows(0, tiles.tiles_y);
+	}
+
+	std::uint32_t offset = 0;
+	for (std::size_t t = 0; t < tile_lists.size(); ++t) {
+		tile_lists[t].x = offset;
+		cursors[t]      = offset;
+		offset += tile_lists[t].y;
+	}
+	indices.resize(offset);
+
+	if (jobs) {
+		jobs->parallel_for(tiles.tiles_y, 1, fill_rows);
+	}
+	else {
+		fill_rows(0, tiles.tiles_y);
+	}
+}
+
+void Light_Tiles::cull(const glm::vec4* view_positions, std::size_t begin, std::size_t end) {
+	for (std::size_t i = begin; i < end; ++i) {
+		inside[i] = sphere_in_frustum(frustum, view_positions[i]);
+
+		Tile_Range range = sphere_tiles(tiles, view_positions[i]);
+		min_x[i]         = range.min_x;
+		max_x[i]         = range.max_x;
+		min_y[i]         = range.min_y;
+		max_y[i]         = range.max_y;
+	}
+}
+
+template <class Func>
+void Light_Tiles::scan_row(std::int32_t y, const glm::vec4* view_positions, Func&& func) const {
+	const glm::vec2 bottom = row_planes[y];
+	const glm::vec2 top    = row_planes[y + 1];
+
+	for (std::uint32_t i : visible) {
+		if (min_y[i] > y || max_y[i] < y) {
+			continue;
+		}
+
+		glm::vec4 l = view_positions[i];
+		if (bottom.x * l.y + bottom.y * l.z < -l.w || -top.x * l.y - top.y * l.z < -l.w) {
+			continue;
+		}
+
+		for (std::int32_t x = min_x[i]; x <= max_x[i]; ++x) {
+			const glm::vec2 left  = column_planes[x];
+			const glm::vec2 right = column_planes[x + 1];
+			if (left.x * l.x + left.y * l.z >= -l.w && -right.x * l.x - right.y * l.z >= -l.w) {
+				func(x, i);
+			}
+		}
+	}
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "jobsystem.hpp"
+#include "util.hpp"
+
+// CPU light culling math: the sphere vs frustum and sphere vs screen tile
+// tests behind the tiled and clustered light passes, usable without a GL
+// context. Lights are view space spheres (position, radius), as written to
+// Light_Targets::view_positions by Light_System::update.
+
+// A point p is inside when dot(xyz, p) + w >= 0.
+using Plane = glm::vec4;
+
+struct Frustum {
+	Plane planes[6]; // Left, right, bottom, top, near, far
+};
+
+// View space frustum of a projection matrix.
+Frustum make_frustum(const glm::mat4& projection);
+bool sphere_in_frustum(const Frustum& frustum, const glm::vec4& sphere);
+
+// Maps view space onto a grid of tile_size pixel screen tiles for a symmetric perspective projection.
+struct Tile_Projection {
+	Tile_Projection() = default;
+	Tile_Projection(const glm::mat4& projection, float z_near, std::size_t width, std::size_t height, std::size_t tile_size);
+
+	std::int32_t tiles_x = 0;
+	std::int32_t tiles_y = 0;
+
+	float proj_x       = 0; // projection[0][0]
+	float proj_y       = 0; // projection[1][1]
+	float z_near       = 0;
+	float tile_scale_x = 0; // NDC to tile coordinate, x * scale + scale
+	float tile_scale_y = 0;
+};
+
+// Inclusive range of tiles, empty if min > max.
+struct Tile_Range {
+	std::int32_t min_x, max_x;
+	std::int32_t min_y, max_y;
+};
+
+// floor(x) clamped to [-1, limit] before the conversion, so far off screen lights can't overflow.
+std::int32_t grid_cell(float x, std::int32_t limit);
+
+// Conservative tiles a sphere can cover, from projecting its view space bounding box.
+// Spheres crossing the near plane cover the whole screen.
+Tile_Range sphere_tiles(const Tile_Projection& tiles, const glm::vec4& sphere);
+
+// Per tile light lists, the CPU counterpart of the tiled lighting compute pass.
+//
+// Lights are frustum culled, then tested against the side planes of every
+// tile in their projected range. Without a depth buffer each tile spans the
+// whole depth range. Tiles are ordered x fastest and each tile's lights are in
+// ascending order no matter how many threads did the work.
+class Light_Tiles {
+  public:
+	void build(const glm::vec4* view_positions, std::size_t count, const glm::mat4& projection, float z_near,
+	           std::size_t width, std::size_t height, std::size_t tile_size, Job_System* jobs = nullptr);
+
+	std::size_t grid_width() const {
+		return tiles.tiles_x;
+	}
+	std::size_t grid_height() const {
+		return tiles.tiles_y;
+	}
+	// Lights left after frustum culling
+	std::size_t visible_count() const {
+		return visible.size();
+	}
+
+	// Offset into get_indices() and light count for each tile.
+	const std::vector<glm::uvec2>& get_tiles() const {
+		return tile_lists;
+	}
+	const std::vector<std::uint32_t>& get_indices() const {
+		return indices;
+	}
+
+  private:
+	using Int_Array = std::vector<std::int32_t, Aligned_Allocator<std::int32_t>>;
+
+	void cull(const glm::vec4* view_positions, std::size_t begin, std::size_t end);
+	template <class Func>
+	void scan_row(std::int32_t row, const glm::vec4* view_positions, Func&& func) const;
+
+	Tile_Projection tiles;
+	Frustum frustum;
+
+	// Side planes through the eye at each tile column and row edge, pointing into the higher tile
+	std::vector<glm::vec2> column_planes; // x, z
+	std::vector<glm::vec2> row_planes;    // y, z
+
+	// Per light frustum test result and tile range, then the compacted visible light indices
+	std::vector<std::uint8_t> inside;
+	Int_Array min_x, max_x;
+	Int_Array min_y, max_y;
+	std::vector<std::uint32_t> visible;
+
+	std::vector<glm::uvec2> tile_lists;
+	std::vector<std::uint32_t> indices;
+	std::vector<std::uint32_t> cursors;
+};
@@ -0,0 +1,135 @@
+#include "lightsystem_kernel.hpp"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+
+#include <immintrin.h>
+
+namespace {
+	// Same reduction and polynomials as the SSE4 kernel, eight lanes with FMA.
+	void sincos_ps(__m256 x, __m256& s, __m256& c) {
+		const __m256 two_over_pi = _mm256_set1_ps(0.636619772f);
+		const __m256 pio2_1      = _mm256_set1_ps(1.5703125f);
+		const __m256 pio2_2      = _mm256_set1_ps(4.837512969970703125e-4f);
+		const __m256 pio2_3      = _mm256_set1_ps(7.54978995489188216e-8f);
+
+		__m256 q  = _mm256_round_ps(_mm256_mul_ps(x, two_over_pi), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m256 r  = _mm256_fnmadd_ps(q, pio2_1, x);
+		r         = _mm256_fnmadd_ps(q, pio2_2, r);
+		r         = _mm256_fnmadd_ps(q, pio2_3, r);
+		__m256i k = _mm256_cvtps_epi32(q);
+
+		__m256 r2 = _mm256_mul_ps(r, r);
+
+		__m256 ps = _mm256_fmadd_ps(_mm256_set1_ps(-1.9515295891e-4f), r2, _mm256_set1_ps(8.3321608736e-3f));
+		ps        = _mm256_fmadd_ps(ps, r2, _mm256_set1_ps(-1.6666654611e-1f));
+		ps        = _mm256_fmadd_ps(_mm256_mul_ps(ps, r2), r, r);
+
+		__m256 pc = _mm256_fmadd_ps(_mm256_set1_ps(2.443315711809948e-5f), r2, _mm256_set1_ps(-1.388731625493765e-3f));
+		pc        = _mm256_fmadd_ps(pc, r2, _mm256_set1_ps(4.166664568298827e-2f));
+		pc        = _mm256_fmadd_ps(_mm256_mul_ps(pc, r2), r2, _mm256_fnmadd_ps(r2, _mm256_set1_ps(0.5f), _mm256_set1_ps(1.0f)));
+
+		__m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(k, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+		s           = _mm256_blendv_ps(ps, pc, swap);
+		c           = _mm256_blendv_ps(pc, ps, swap);
+
+		__m256i sin_sign = _mm256_slli_epi32(_mm256_and_si256(k, _mm256_set1_epi32(2)), 30);
+		__m256i cos_sign =
+		    _mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(k, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30);
+		s = _mm256_xor_ps(s, _mm256_castsi256_ps(sin_sign));
+		c = _mm256_xor_ps(c, _mm256_castsi256_ps(cos_sign));
+	}
+
+	// 4x4 transpose within each 128-bit lane: afterwards v[l] holds lights l and l + 4.
+	void transpose_lanes(__m256 v[4]) {
+		__m256 t0 = _mm256_unpacklo_ps(v[0], v[1]);
+		__m256 t1 = _mm256_unpackhi_ps(v[0], v[1]);
+		__m256 t2 = _mm256_unpacklo_ps(v[2], v[3]);
+		__m256 t3 = _mm256_unpackhi_ps(v[2], v[3]);
+		v[0]      = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		v[1]      = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		v[2]      = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		v[3]      = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	}
+
+	// Writes eight column major matrices rotate(y) * scale(k) with translation p.
+	void store_matrices(float* out, __m256 s, __m256 c, __m256 k, __m256 px, __m256 py, __m256 pz) {
+		__m256 zero = _mm256_setzero_ps();
+		__m256 ck   = _mm256_mul_ps(c, k);
+		__m256 sk   = _mm256_mul_ps(s, k);
+		__m256 nsk  = _mm256_sub_ps(zero, sk);
+
+		__m256 col0[4] = {ck, zero, nsk, zero};
+		__m256 col1[4] = {zero, k, zero, zero};
+		__m256 col2[4] = {sk, zero, ck, zero};
+		__m256 col3[4] = {px, py, pz, _mm256_set1_ps(1.0f)};
+
+		transpose_lanes(col0);
+		transpose_lanes(col1);
+		transpose_lanes(col2);
+		transpose_lanes(col3);
+
+		for (int l = 0; l < 4; ++l) {
+			_mm256_storeu_ps(out + l * 16 + 0, _mm256_permute2f128_ps(col0[l], col1[l], 0x20));
+			_mm256_storeu_ps(out + l * 16 + 8, _mm256_permute2f128_ps(col2[l], col3[l], 0x20));
+			_mm256_storeu_ps(out + (l + 4) * 16 + 0, _mm256_permute2f128_ps(col0[l], col1[l], 0x31));
+			_mm256_storeu_ps(out + (l + 4) * 16 + 8, _mm256_permute2f128_ps(col2[l], col3[l], 0x31));
+		}
+	}
+} // namespace
+
+std::size_t update_lights_avx2(const Light_Kernel_Args& args) {
+	const __m256 two_pi = _mm256_set1_ps(6.28318530717958647692f);
+	const __m256 delta  = _mm256_set1_ps(args.orbit_delta);
+	const __m256 sprite = _mm256_set1_ps(args.sprite_scale);
+
+	__m256 view[16];
+	for (int e = 0; e < 16; ++e) {
+		view[e] = _mm256_set1_ps(args.view[e]);
+	}
+
+	std::size_t i = args.begin;
+	for (; i + 8 <= args.end; i += 8) {
+		__m256 o = _mm256_add_ps(_mm256_loadu_ps(args.orbit + i), delta);
+		o        = _mm256_sub_ps(o, _mm256_and_ps(_mm256_cmp_ps(o, two_pi, _CMP_GE_OQ), two_pi));
+		_mm256_storeu_ps(args.orbit + i, o);
+
+		__m256 s, c;
+		sincos_ps(o, s, c);
+
+		__m256 d  = _mm256_loadu_ps(args.distance + i);
+		__m256 px = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_mul_ps(d, s));
+		__m256 py = _mm256_loadu_ps(args.height + i);
+		__m256 pz = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_mul_ps(d, c));
+		__m256 r  = _mm256_loadu_ps(args.radius + i);
+
+		if (args.view_positions) {
+			__m256 pos[4];
+			for (int row = 0; row < 3; ++row) {
+				pos[row] = _mm256_fmadd_ps(view[row], px, _mm256_fmadd_ps(view[4 + row], py, _mm256_fmadd_ps(view[8 + row], pz, view[12 + row])));
+			}
+			pos[3] = r;
+			transpose_lanes(pos);
+			for (int l = 0; l < 4; ++l) {
+				_mm_storeu_ps(args.view_positions + (i + l) * 4, _mm256_castps256_ps128(pos[l]));
+				_mm_storeu_ps(args.view_positions + (i + l + 4) * 4, _mm256_extractf128_ps(pos[l], 1));
+			}
+		}
+
+		if (args.volume_matrices) {
+			store_matrices(args.volume_matrices + i * 16, s, c, r, px, py, pz);
+		}
+		if (args.sprite_matrices) {
+			store_matrices(args.sprite_matrices + i * 16, s, c, _mm256_mul_ps(r, sprite), px, py, pz);
+		}
+	}
+
+	return i;
+}
+
+#else
+
+std::size_t update_lights_avx2(const Light_Kernel_Args& args) {
+	return args.begin;
+}
+
+#endif
@@ -0,0 +1,127 @@
+#include "lightsystem_kernel.hpp"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+
+#include <smmintrin.h>
+
+namespace {
+	// sin and cos of x in [0, 2pi), accurate to a couple of ulp.
+	// Reduces to [-pi/4, pi/4] by quadrant then uses the cephes minimax polynomials.
+	void sincos_ps(__m128 x, __m128& s, __m128& c) {
+		const __m128 two_over_pi = _mm_set1_ps(0.636619772f);
+		// pi/2 split in three so q * pi/2 is exact for the quadrants we see
+		const __m128 pio2_1 = _mm_set1_ps(1.5703125f);
+		const __m128 pio2_2 = _mm_set1_ps(4.837512969970703125e-4f);
+		const __m128 pio2_3 = _mm_set1_ps(7.54978995489188216e-8f);
+
+		__m128 q  = _mm_round_ps(_mm_mul_ps(x, two_over_pi), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m128 r  = _mm_sub_ps(x, _mm_mul_ps(q, pio2_1));
+		r         = _mm_sub_ps(r, _mm_mul_ps(q, pio2_2));
+		r         = _mm_sub_ps(r, _mm_mul_ps(q, pio2_3));
+		__m128i k = _mm_cvtps_epi32(q);
+
+		__m128 r2 = _mm_mul_ps(r, r);
+
+		__m128 ps = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-1.9515295891e-4f), r2), _mm_set1_ps(8.3321608736e-3f));
+		ps        = _mm_add_ps(_mm_mul_ps(ps, r2), _mm_set1_ps(-1.6666654611e-1f));
+		ps        = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ps, r2), r), r);
+
+		__m128 pc = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.443315711809948e-5f), r2), _mm_set1_ps(-1.388731625493765e-3f));
+		pc        = _mm_add_ps(_mm_mul_ps(pc, r2), _mm_set1_ps(4.166664568298827e-2f));
+		pc        = _mm_mul_ps(_mm_mul_ps(pc, r2), r2);
+		pc        = _mm_add_ps(_mm_sub_ps(pc, _mm_mul_ps(r2, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+		// Odd quadrants swap sin and cos
+		__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(k, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+		s           = _mm_blendv_ps(ps, pc, swap);
+		c           = _mm_blendv_ps(pc, ps, swap);
+
+		// sin is negative in quadrants 2 and 3, cos in 1 and 2
+		__m128i sin_sign = _mm_slli_epi32(_mm_and_si128(k, _mm_set1_epi32(2)), 30);
+		__m128i cos_sign = _mm_slli_epi32(_mm_and_si128(_mm_add_epi32(k, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30);
+		s                = _mm_xor_ps(s, _mm_castsi128_ps(sin_sign));
+		c                = _mm_xor_ps(c, _mm_castsi128_ps(cos_sign));
+	}
+
+	// Writes four column major matrices rotate(y) * scale(k) with translation p.
+	void store_matrices(float* out, __m128 s, __m128 c, __m128 k, __m128 px, __m128 py, __m128 pz) {
+		__m128 zero = _mm_setzero_ps();
+		__m128 ck   = _mm_mul_ps(c, k);
+		__m128 sk   = _mm_mul_ps(s, k);
+		__m128 nsk  = _mm_sub_ps(zero, sk);
+
+		__m128 col0[4] = {ck, zero, nsk, zero};
+		__m128 col1[4] = {zero, k, zero, zero};
+		__m128 col2[4] = {sk, zero, ck, zero};
+		__m128 col3[4] = {px, py, pz, _mm_set1_ps(1.0f)};
+
+		_MM_TRANSPOSE4_PS(col0[0], col0[1], col0[2], col0[3]);
+		_MM_TRANSPOSE4_PS(col1[0], col1[1], col1[2], col1[3]);
+		_MM_TRANSPOSE4_PS(col2[0], col2[1], col2[2], col2[3]);
+		_MM_TRANSPOSE4_PS(col3[0], col3[1], col3[2], col3[3]);
+
+		for (int l = 0; l < 4; ++l) {
+			_mm_storeu_ps(out + l * 16 + 0, col0[l]);
+			_mm_storeu_ps(out + l * 16 + 4, col1[l]);
+			_mm_storeu_ps(out + l * 16 + 8, col2[l]);
+			_mm_storeu_ps(out + l * 16 + 12, col3[l]);
+		}
+	}
+} // namespace
+
+std::size_t update_lights_sse4(const Light_Kernel_Args& args) {
+	const __m128 two_pi = _mm_set1_ps(6.28318530717958647692f);
+	const __m128 delta  = _mm_set1_ps(args.orbit_delta);
+	const __m128 sprite = _mm_set1_ps(args.sprite_scale);
+
+	__m128 view[16];
+	for (int e = 0; e < 16; ++e) {
+		view[e] = _mm_set1_ps(args.view[e]);
+	}
+
+	std::size_t i = args.begin;
+	for (; i + 4 <= args.end; i += 4) {
+		__m128 o = _mm_add_ps(_mm_loadu_ps(args.orbit + i), delta);
+		o        = _mm_sub_ps(o, _mm_and_ps(_mm_cmpge_ps(o, two_pi), two_pi));
+		_mm_storeu_ps(args.orbit + i, o);
+
+		__m128 s, c;
+		sincos_ps(o, s, c);
+
+		__m128 d  = _mm_loadu_ps(args.distance + i);
+		__m128 px = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(d, s));
+		__m128 py = _mm_loadu_ps(args.height + i);
+		__m128 pz = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(d, c));
+		__m128 r  = _mm_loadu_ps(args.radius + i);
+
+		if (args.view_positions) {
+			__m128 pos[4];
+			for (int row = 0; row < 3; ++row) {
+				pos[row] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(view[row], px), _mm_mul_ps(view[4 + row], py)),
+				                      _mm_add_ps(_mm_mul_ps(view[8 + row], pz), view[12 + row]));
+			}
+			pos[3] = r;
+			_MM_TRANSPOSE4_PS(pos[0], pos[1], pos[2], pos[3]);
+			for (int l = 0; l < 4; ++l) {
+				_mm_storeu_ps(args.view_positions + (i + l) * 4, pos[l]);
+			}
+		}
+
+		if (args.volume_matrices) {
+			store_matrices(args.volume_matrices + i * 16, s, c, r, px, py, pz);
+		}
+		if (args.sprite_matrices) {
+			store_matrices(args.sprite_matrices + i * 16, s, c, _mm_mul_ps(r, sprite), px, py, pz);
+		}
+	}
+
+	return i;
+}
+
+#else
+
+std::size_t update_lights_sse4(const Light_Kernel_Args& args) {
+	return args.begin;
+}
+
+#endif
@@ -0,0 +1,219 @@
+#include "lightsystem.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	void light_transform(float o, float d, float h, float r, float sprite_scale, const float* v, float* pos,
+	                     float* volume, float* sprite) {
+		float s = std::sin(o);
+		float c = std::cos(o);
+
+		// rotate(orbit, y) * translate(0, height, -distance)
+		float px = -d * s;
+		float py = h;
+		float pz = -d * c;
+
+		if (pos) {
+			pos[0] = v[0] * px + v[4] * py + v[8] * pz + v[12];
+			pos[1] = v[1] * px + v[5] * py + v[9] * pz + v[13];
+			pos[2] = v[2] * px + v[6] * py + v[10] * pz + v[14];
+			pos[3] = r;
+		}
+
+		float* matrices[2] = {volume, sprite};
+		float scales[2]    = {r, r * sprite_scale};
+
+		for (std::size_t m = 0; m < 2; ++m) {
+			float* out = matrices[m];
+			float k    = scales[m];
+			if (!out) {
+				continue;
+			}
+
+			out[0]  = c * k;
+			out[1]  = 0;
+			out[2]  = -s * k;
+			out[3]  = 0;
+			out[4]  = 0;
+			out[5]  = k;
+			out[6]  = 0;
+			out[7]  = 0;
+			out[8]  = s * k;
+			out[9]  = 0;
+			out[10] = c * k;
+			out[11] = 0;
+			out[12] = px;
+			out[13] = py;
+			out[14] = pz;
+			out[15] = 1;
+		}
+	}
+} // namespace
+
+constexpr float Light_System::sprite_scale;
+constexpr std::size_t Light_System::min_batch_size;
+
+Light_System::Light_System() : kernel_type(Kernel::scalar), kernel(update_lights_scalar) {
+	if (!set_kernel(Kernel::avx2)) {
+		set_kernel(Kernel::sse4);
+	}
+}
+
+bool Light_System::set_kernel(Kernel k) {
+	if (!kernel_supported(k)) {
+		return false;
+	}
+
+	kernel_type = k;
+	switch (k) {
+		case Kernel::scalar:
+			kernel = update_lights_scalar;
+			break;
+		case Kernel::sse4:
+			kernel = update_lights_sse4;
+			break;
+		case Kernel::avx2:
+			kernel = update_lights_avx2;
+			break;
+	}
+	return true;
+}
+
+const char* Light_System::kernel_name(Kernel k) {
+	switch (k) {
+		case Kernel::scalar:
+			return "scalar";
+		case Kernel::sse4:
+			return "sse4";
+		case Kernel::avx2:
+			return "avx2";
+	}
+	return "unknown";
+}
+
+bool Light_System::kernel_supported(Kernel k) {
+	switch (k) {
+		case Kernel::scalar:
+			return true;
+		case Kernel::sse4:
+			return cpu_has_sse41();
+		case Kernel::avx2:
+			return cpu_has_avx2();
+	}
+	return false;
+}
+
+void Light_System::add(float d, float o, float h, const glm::vec3& c) {
+	// Distance at which the attenuated light drops below 5/256
+	constexpr float constant  = 1.0;
+	constexpr float linear    = 0.7;
+	constexpr float quadratic = 1.8;
+	float lightMax            = std::max(std::max(c.r, c.g), c.b);
+	float r = (-linear + std::sqrt(linear * linear - 4 * quadratic * (constant - (256.0 / 5.0) * lightMax))) / (2 * quadratic);
+
+	orbit.push_back(o);
+	distance.push_back(d);
+	height.push_back(h);
+	radius.push_back(r);
+	red.push_back(c.r);
+	green.push_back(c.g);
+	blue.push_back(c.b);
+}
+
+void Light_System::pop_back() {
+	orbit.pop_back();
+	distance.pop_back();
+	height.pop_back();
+	radius.pop_back();
+	red.pop_back();
+	green.pop_back();
+	blue.pop_back();
+}
+
+void Light_System::reserve(std::size_t n) {
+	orbit.reserve(n);
+	distance.reserve(n);
+	height.reserve(n);
+	radius.reserve(n);
+	red.reserve(n);
+	green.reserve(n);
+	blue.reserve(n);
+}
+
+void Light_System::write_colors(glm::vec3* out) const {
+	for (std::size_t i = 0; i < count(); ++i) {
+		out[i] = glm::vec3(red[i], green[i], blue[i]);
+	}
+}
+
+void Light_System::update(float orbit_delta, const glm::mat4& view, const Light_Targets& targets, Job_System* jobs) {
+	last_view = view;
+
+	Light_Kernel_Args args;
+	args.orbit        = orbit.data();
+	args.distance     = distance.data();
+	args.height       = height.data();
+	args.radius       = radius.data();
+	args.orbit_delta  = orbit_delta;
+	args.sprite_scale = sprite_scale;
+	args.view         = glm::value_ptr(view);
+	args.begin        = 0;
+	args.end          = count();
+
+	if (args.end == 0) {
+		return;
+	}
+
+	args.view_positions  = reinterpret_cast<float*>(targets.view_positions);
+	args.volume_matrices = reinterpret_cast<float*>(targets.volume_matrices);
+	args.sprite_matrices = reinterpret_cast<float*>(targets.sprite_matrices);
+
+	auto run = [this, &args](std::size_t begin, std::size_t end) {
+		Light_Kernel_Args batch = args;
+		batch.begin             = begin;
+		batch.end               = end;
+
+		// The vector kernels leave the tail that doesn't fill a register
+		batch.begin = kernel(batch);
+		update_lights_scalar(batch);
+	};
+
+	if (!jobs) {
+		run(args.begin, args.end);
+		return;
+	}
+
+	// A few batches per thread lets stealing even out uneven progress.
+	// Batches stay a multiple of min_batch_size so only the final one has a scalar tail.
+	std::size_t batch = args.end / (jobs->thread_count() * 4);
+	batch             = std::max(min_batch_size, (batch + min_batch_size - 1) / min_batch_size * min_batch_size);
+	jobs->parallel_for(args.end, batch, run);
+}
+
+Light_Transform Light_System::transform(std::size_t i) const {
+	Light_Transform t;
+	light_transform(orbit[i], distance[i], height[i], radius[i], sprite_scale, glm::value_ptr(last_view),
+	                glm::value_ptr(t.view_position), glm::value_ptr(t.volume_matrix), glm::value_ptr(t.sprite_matrix));
+	return t;
+}
+
+std::size_t update_lights_scalar(const Light_Kernel_Args& args) {
+	constexpr float two_pi = 6.28318530717958647692f;
+
+	for (std::size_t i = args.begin; i < args.end; ++i) {
+		float o = args.orbit[i] + args.orbit_delta;
+		o       = o >= two_pi ? o - two_pi : o;
+		args.orbit[i] = o;
+
+		float* pos    = args.view_positions ? args.view_positions + i * 4 : nullptr;
+		float* volume = args.volume_matrices ? args.volume_matrices + i * 16 : nullptr;
+		float* sprite = args.sprite_matrices ? args.sprite_matrices + i * 16 : nullptr;
+		light_transform(o, args.distance[i], args.height[i], args.radius[i], args.sprite_scale, args.view, pos, volume, sprite);
+	}
+
+	return args.end;
+}
+
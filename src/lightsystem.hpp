@@ -0,0 +1,88 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+#include "jobsystem.hpp"
+#include "lightsystem_kernel.hpp"
+#include "util.hpp"
+
+// Where update() writes its results, count() elements each. Usually mapped GPU buffers, null members are skipped.
+struct Light_Targets {
+	glm::vec4* view_positions  = nullptr;
+	glm::mat4* volume_matrices = nullptr;
+	glm::mat4* sprite_matrices = nullptr;
+};
+
+struct Light_Transform {
+	glm::vec4 view_position; // View space position, radius
+	glm::mat4 volume_matrix;
+	glm::mat4 sprite_matrix;
+};
+
+// Orbiting point lights stored as structure of arrays, with SIMD transform updates.
+//
+// Each light orbits the y axis at a fixed distance and height. Per frame,
+// update() advances the orbit and writes the view space positions and the
+// instance matrices for the light volumes and sprites in one pass, straight
+// into the caller's buffers. Nothing is kept besides the SoA inputs.
+class Light_System {
+  public:
+	enum class Kernel { scalar, sse4, avx2 };
+
+	Light_System();
+
+	// Picks the widest kernel the CPU supports by default.
+	// Returns false and keeps the current one if kernel isn't supported.
+	bool set_kernel(Kernel kernel);
+	Kernel get_kernel() const {
+		return kernel_type;
+	}
+	static const char* kernel_name(Kernel kernel);
+	static bool kernel_supported(Kernel kernel);
+
+	// The radius is derived from the color's brightest channel.
+	void add(float distance, float orbit, float height, const glm::vec3& color);
+	void pop_back();
+	void reserve(std::size_t count);
+
+	std::size_t count() const {
+		return orbit.size();
+	}
+
+	// With jobs, the lights are split into batches across its threads.
+	void update(float orbit_delta, const glm::mat4& view, const Light_Targets& targets, Job_System* jobs = nullptr);
+
+	// One light's results as of the last update(), recomputed for code that can't read the mapped targets.
+	Light_Transform transform(std::size_t i) const;
+
+	glm::vec3 get_color(std::size_t i) const {
+		return glm::vec3(red[i], green[i], blue[i]);
+	}
+	// Interleaves every light's color into out, count() elements, for uploading.
+	void write_colors(glm::vec3* out) const;
+	float get_radius(std::size_t i) const {
+		return radius[i];
+	}
+
+	// Light sprites are drawn at this fraction of the light's radius.
+	static constexpr float sprite_scale = 0.04f;
+	// Smallest batch handed to a job, a multiple of every kernel's width.
+	static constexpr std::size_t min_batch_size = 256;
+
+  private:
+	using Float_Array = std::vector<float, Aligned_Allocator<float>>;
+
+	Float_Array orbit;
+	Float_Array distance;
+	Float_Array height;
+	Float_Array radius;
+	Float_Array red, green, blue;
+
+	glm::mat4 last_view;
+
+	Kernel kernel_type;
+	Light_Kernel kernel;
+};
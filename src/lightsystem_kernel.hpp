@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+
+// Interface between Light_System and its per-ISA update kernels.
+//
+// The -sse4/-avx2 kernels are compiled with wider instruction sets than the
+// rest of the program, so this header must stay free of inline functions and
+// templates (glm, std containers). Otherwise the linker may pick an AVX2 copy
+// of some inline function for code that runs on every CPU.
+
+struct Light_Kernel_Args {
+	float* orbit;           // Advanced by orbit_delta and wrapped to [0, 2pi)
+	const float* distance;
+	const float* height;
+	const float* radius;
+
+	float orbit_delta;
+	float sprite_scale;
+	const float* view; // Column major 4x4
+
+	// Outputs, each skipped if null
+	float* view_positions;  // vec4 per light: view space position, radius
+	float* volume_matrices; // Column major 4x4 per light, scaled by radius
+	float* sprite_matrices; // Column major 4x4 per light, scaled by radius * sprite_scale
+
+	std::size_t begin;
+	std::size_t end;
+};
+
+// Each kernel handles as many lights as fit its vector width starting at begin and returns where it stopped.
+// The scalar kernel always finishes the range.
+using Light_Kernel = std::size_t (*)(const Light_Kernel_Args& args);
+
+std::size_t update_lights_scalar(const Light_Kernel_Args& args);
+std::size_t update_lights_sse4(const Light_Kernel_Args& args);
+std::size_t update_lights_avx2(const Light_Kernel_Args& args);
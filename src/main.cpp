@@ -7,6 +7,9 @@
 
 #include <cassert>
 #include <cmath>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
 #include <vector>
 #include <utility>
 #include <iterator>
@@ -16,12 +19,25 @@
 #include <unordered_map>
 #include <sstream>
 #include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
 
-#include "objparser.hpp"
+#include "meshcache.hpp"
 #include "sdlmanager.hpp"
 #include "camera.hpp"
 #include "fps_meter.hpp"
+#include "glstate.hpp"
+#include "jobsystem.hpp"
+#include "lightclusters.hpp"
+#include "lightsystem.hpp"
+#include "profiler.hpp"
+#include "readbackbuffer.hpp"
+#include "renderer.hpp"
+#include "rendertargetpool.hpp"
 #include "shader.hpp"
+#include "streambuffer.hpp"
+#include "vertexlayout.hpp"
 
 #ifdef _WIN32
 #define APIENTRY __stdcall
@@ -30,22 +46,68 @@
 #endif
 
 struct RenderInfo {
+	// Compact drops gPosition (rebuilt from gDepth) and stores gNormal octahedral in RG16
+	bool compactGBuffer = true;
+	// lBuffer tests against gDepth itself instead of a blitted copy, needs texture barriers
+	bool sharedDepth = true;
 	GLuint gBuffer;
 	GLuint gPosition, gNormal, gAlbedoSpec, gDepth;
 	GLuint lBuffer;
+	// lColor without depth, for full screen passes that sample gDepth while it's shared
+	GLuint lColorBuffer;
 	GLuint lColor, lDepth;
 	GLuint ssaoBuffer, ssaoBlurBuffer;
 	GLuint ssaoNoiseTexture; 
 	GLuint ssaoColor, ssaoDepth, ssaoBlurColor;
 
+	// Reduced resolution SSAO, only allocated when ssaoScale > 1
+	size_t ssaoScale = 1;
+	GLuint ssaoLowBuffer, ssaoLowBlurBuffer[2];
+	GLuint ssaoLowColor, ssaoLowDepth, ssaoLowBlurColor[2];
+
+	// Temporal SSAO history, ping-ponged every frame, only allocated when ssaoTemporal
+	bool ssaoTemporal = false;
+	size_t ssaoHistoryIndex = 0;
+	GLuint ssaoHistoryBuffer[2];
+	GLuint ssaoHistory[2];
+
+	// Every texture above comes from here
+	Render_Target_Pool targets;
 };
 
+enum class Render_Mode { deferred, tiled, clustered, forward };
+
+constexpr float NearPlane = 0.5f;
+constexpr float FarPlane = 1000.0f;
+
+// The Frame uniform block in shaders/frame.glsl, std140 layout
+struct Frame_Constants {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 inverse_projection;
+	glm::vec3 view_position;
+	float time;
+	glm::vec2 resolution;
+	float padding[2]; // std140 rounds the block up to a multiple of 16
+};
+static_assert(sizeof(Frame_Constants) == 224, "Frame_Constants doesn't match the std140 Frame block");
+constexpr GLuint FrameBlockBinding = 0;
+
 void APIENTRY openglCallbackFunction(GLenum, GLenum, GLuint, GLenum, GLsizei,
 									 const GLchar *, const void *);
-void RenderFullscreenQuad();
+void RenderFullscreenQuad(GL_State& gl);
+GLenum IndexType(const Mesh_Object& obj);
+void BindInstanceMatrix(GL_State& gl, GLuint location, const Stream_Buffer& stream);
+struct Vertex_Transform {
+	glm::vec3 scale;
+	glm::vec3 bias;
+};
+Vertex_Transform UploadVertices(const Mesh_Object& obj, bool packed);
 void PrepareBuffers(size_t x, size_t y, RenderInfo& data);
+size_t GBufferBytesPerPixel(bool compact);
 void DeleteBuffers(RenderInfo& data);
 glm::mat4 Resize(SDL_Manager& sdlm, RenderInfo& data);
+void DumpFrame(const std::string& path, SDL_Manager& sdlm);
 
 template<class T1, class T2, class T3>
 auto lerp(T1 a, T2 b, T3 f) {
@@ -53,15 +115,111 @@ auto lerp(T1 a, T2 b, T3 f) {
 }
 
 int main(int argc, char ** argv) {
-	(void) argc;
-	(void) argv;
+	bool packed_vertices = false;
+
+	// Headless benchmark: renders a scripted fly around offscreen for bench_frames
+	// frames at each light count, writing per pass timings to bench_csv.
+	bool headless = false;
+	size_t bench_frames = 300;
+	std::vector<size_t> bench_lights = {100, 1000, 10000};
+	std::string bench_csv = "benchmark.csv";
+	std::string bench_mode;
+	std::string dump_frame;
+	std::string trace_file = "trace.json";
+	size_t ssao_scale = 1;
+	bool ssao_temporal = false;
+	bool compact_gbuffer = true;
+	bool depth_blits = false;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		auto value = [&] {
+			if (i + 1 == argc) {
+				std::cerr << "Missing value for argument: " << arg << '\n';
+				throw std::runtime_error("Missing argument value");
+			}
+			return std::string(argv[++i]);
+		};
+
+		if (arg == "--packed-vertices") {
+			packed_vertices = true;
+		}
+		else if (arg == "--headless") {
+			headless = true;
+		}
+		else if (arg == "--frames") {
+			bench_frames = std::max<size_t>(1, std::stoul(value()));
+		}
+		else if (arg == "--lights") {
+			std::istringstream list(value());
+			bench_lights.clear();
+			for (std::string count; std::getline(list, count, ',');) {
+				bench_lights.push_back(std::stoul(count));
+			}
+		}
+		else if (arg == "--csv") {
+			bench_csv = value();
+		}
+		else if (arg == "--mode") {
+			bench_mode = value();
+		}
+		else if (arg == "--dump-frame") {
+			dump_frame = value();
+		}
+		else if (arg == "--trace") {
+			trace_file = value();
+		}
+		else if (arg == "--depth-blits") {
+			depth_blits = true;
+		}
+		else if (arg == "--gbuffer") {
+			std::string layout = value();
+			if (layout == "compact") {
+				compact_gbuffer = true;
+			}
+			else if (layout == "fat") {
+				compact_gbuffer = false;
+			}
+			else {
+				std::cerr << "Unknown G-buffer layout: " << layout << '\n';
+				throw std::runtime_error("Unknown argument");
+			}
+		}
+		else if (arg == "--ssao") {
+			std::string quality = value();
+			if (quality == "full") {
+				ssao_scale = 1;
+				ssao_temporal = false;
+			}
+			else if (quality == "half") {
+				ssao_scale = 2;
+				ssao_temporal = false;
+			}
+			else if (quality == "quarter") {
+				ssao_scale = 4;
+				ssao_temporal = false;
+			}
+			else if (quality == "temporal") {
+				ssao_scale = 1;
+				ssao_temporal = true;
+			}
+			else {
+				std::cerr << "Unknown SSAO resolution: " << quality << '\n';
+				throw std::runtime_error("Unknown argument");
+			}
+		}
+		else {
+			std::cerr << "Unknown argument: " << arg << '\n';
+			throw std::runtime_error("Unknown argument");
+		}
+	}
 
 	//////////////////////////
 	// Parse an object file //
 	//////////////////////////
 
-	auto file = parse_obj_file("monkey.wavobj");
-	auto worldfile = parse_obj_file("world_detailed.wavobj");
+	auto file = load_mesh("monkey.wavobj");
+	auto worldfile = load_mesh("world_detailed.wavobj");
 
 	//auto test_vertex = file.objects[0].vertices[11];
 
@@ -79,7 +237,7 @@ int main(int argc, char ** argv) {
 	// SDL Setup //
 	///////////////
 
-	SDL_Manager sdlm;
+	SDL_Manager sdlm(headless);
 	
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_CULL_FACE);
@@ -108,13 +266,22 @@ int main(int argc, char ** argv) {
 	// Setup Random Number Generator //
 	///////////////////////////////////
 
-	std::mt19937 prng(std::random_device{}());
+	// Fixed seed when benchmarking so every run has the same lights
+	std::mt19937 prng(headless ? 1 : std::random_device{}());
 
 	/////////////////
 	// Shader Prep //
 	/////////////////
 
+	// Every pass reading the G-buffer is built for the chosen layout
+	auto DefineGBufferLayout = [&](Shader_Program& program) {
+		if (compact_gbuffer) {
+			program.define("COMPACT_GBUFFER");
+		}
+	};
+
 	Shader_Program geometrypass;
+	DefineGBufferLayout(geometrypass);
 	geometrypass.add("shaders/geometry.v.glsl", Shader::VERTEX);
 	geometrypass.add("shaders/geometry.f.glsl", Shader::FRAGMENT);
 	geometrypass.compile();
@@ -122,40 +289,39 @@ int main(int argc, char ** argv) {
 	geometrypass.use();
 
 	auto uGeoWorld = geometrypass.getUniform("world", Shader::MANDITORY);
-	auto uGeoView = geometrypass.getUniform("view", Shader::MANDITORY);
-	auto uGeoProjection = geometrypass.getUniform("projection", Shader::MANDITORY);
+	auto uGeoPositionScale = geometrypass.getUniform("positionScale", Shader::MANDITORY);
+	auto uGeoPositionBias = geometrypass.getUniform("positionBias", Shader::MANDITORY);
+	glUniform1i(geometrypass.getUniform("octNormals", Shader::MANDITORY), packed_vertices);
 
 	auto world_world = glm::scale(glm::translate(glm::mat4(), glm::vec3(0, 5, 0)), glm::vec3(10, 10, 10));
 	auto monkey_world = glm::translate(glm::mat4(), glm::vec3(0, 0, 0));
-	auto projection = glm::perspective(glm::radians(60.0f), sdlm.size.ratio, 0.5f, 1000.0f);
+	auto projection = glm::perspective(glm::radians(60.0f), sdlm.size.ratio, NearPlane, FarPlane);
 
 	Shader_Program lightingpass;
+	DefineGBufferLayout(lightingpass);
 	lightingpass.add("shaders/lighting.v.glsl", Shader::VERTEX);
 	lightingpass.add("shaders/lighting.f.glsl", Shader::FRAGMENT);
 	lightingpass.compile();
 	lightingpass.link();
 
-	auto uLightViewPos = lightingpass.getUniform("viewPos");
+	auto uLightSSAOEnabled = lightingpass.getUniform("ssaoEnabled");
 
 	// Set gBuffer textures
 	lightingpass.use();
 	glUniform1i(lightingpass.getUniform("gPosition"), 0);
 	glUniform1i(lightingpass.getUniform("gNormal"), 1);
 	glUniform1i(lightingpass.getUniform("gAlbedoSpec"), 2);
+	glUniform1i(lightingpass.getUniform("gDepth"), 6);
 	glUniform1i(lightingpass.getUniform("ssaoInput"), 5);
 
 	Shader_Program lightbound;
+	DefineGBufferLayout(lightbound);
 	lightbound.add("shaders/lighteffect.v.glsl", Shader::VERTEX);
 	lightbound.add("shaders/lighteffect.f.glsl", Shader::FRAGMENT);
 	lightbound.compile();
 	lightbound.link();
 
 	auto uLightBoundWorld = lightbound.getUniform("world", Shader::MANDITORY);
-	auto uLightBoundView = lightbound.getUniform("view", Shader::MANDITORY);
-	auto uLightBoundPerspective = lightbound.getUniform("perspective", Shader::MANDITORY);
-
-	auto uLightBoundViewPos = lightbound.getUniform("viewPos");
-	auto uLightBoundResolution = lightbound.getUniform("resolution");
 
 	auto uLightBoundLightPosition = lightbound.getUniform("lightposition");
 	auto uLightBoundLightColor = lightbound.getUniform("lightcolor");
@@ -166,6 +332,43 @@ int main(int argc, char ** argv) {
 	glUniform1i(lightbound.getUniform("gPosition"), 0);
 	glUniform1i(lightbound.getUniform("gNormal"), 1);
 	glUniform1i(lightbound.getUniform("gAlbedoSpec"), 2);
+	glUniform1i(lightbound.getUniform("gDepth"), 6);
+
+	Shader_Program lightinstanced;
+	DefineGBufferLayout(lightinstanced);
+	lightinstanced.add("shaders/lighteffect-instanced.v.glsl", Shader::VERTEX);
+	lightinstanced.add("shaders/lighteffect-instanced.f.glsl", Shader::FRAGMENT);
+	lightinstanced.compile();
+	lightinstanced.link();
+
+	lightinstanced.use();
+	glUniform1i(lightinstanced.getUniform("gPosition"), 0);
+	glUniform1i(lightinstanced.getUniform("gNormal"), 1);
+	glUniform1i(lightinstanced.getUniform("gAlbedoSpec"), 2);
+	glUniform1i(lightinstanced.getUniform("gDepth"), 6);
+
+	// Tiled lighting needs compute shaders, without them it's left out of the mode cycle
+	bool tiled_supported = GLEW_VERSION_4_3;
+	Shader_Program lighttiled;
+	GLuint uLightTiledLightCount = 0, uLightTiledHeatmap = 0;
+	if (tiled_supported) {
+		DefineGBufferLayout(lighttiled);
+		lighttiled.add("shaders/lighting-tiled.c.glsl", Shader::COMPUTE);
+		lighttiled.compile();
+		lighttiled.link();
+
+		uLightTiledLightCount = lighttiled.getUniform("lightCount", Shader::MANDITORY);
+		uLightTiledHeatmap = lighttiled.getUniform("heatmap", Shader::MANDITORY);
+
+		lighttiled.use();
+		glUniform1i(lighttiled.getUniform("gPosition"), 0);
+		glUniform1i(lighttiled.getUniform("gNormal"), 1);
+		glUniform1i(lighttiled.getUniform("gAlbedoSpec"), 2);
+		glUniform1i(lighttiled.getUniform("gDepth"), 6);
+	}
+	else {
+		std::cerr << "Compute shaders unavailable, tiled lighting disabled.\n";
+	}
 
 	Shader_Program drawlights;
 	drawlights.add("shaders/drawlight.v.glsl", Shader::VERTEX);
@@ -173,9 +376,6 @@ int main(int argc, char ** argv) {
 	drawlights.compile();
 	drawlights.link();
 
-	auto uDrawLightsView = drawlights.getUniform("view", Shader::MANDITORY);
-	auto uDrawLightsPerspective = drawlights.getUniform("perspective", Shader::MANDITORY);
-
 	Shader_Program forward_sun, forward_lights;
 	forward_sun.add("shaders/geometry.v.glsl", Shader::VERTEX);
 	forward_sun.add("shaders/forward-sun.f.glsl", Shader::FRAGMENT);
@@ -184,10 +384,9 @@ int main(int argc, char ** argv) {
 	forward_sun.use();
 
 	auto uForwardSunWorld = forward_sun.getUniform("world", Shader::MANDITORY);
-	auto uForwardSunView = forward_sun.getUniform("view", Shader::MANDITORY);
-	auto uForwardSunProjection = forward_sun.getUniform("projection", Shader::MANDITORY);
-	
-	glUniformMatrix4fv(uForwardSunProjection, 1, GL_FALSE, glm::value_ptr(projection));
+	auto uForwardSunPositionScale = forward_sun.getUniform("positionScale", Shader::MANDITORY);
+	auto uForwardSunPositionBias = forward_sun.getUniform("positionBias", Shader::MANDITORY);
+	glUniform1i(forward_sun.getUniform("octNormals", Shader::MANDITORY), packed_vertices);
 
 	forward_lights.add("shaders/geometry.v.glsl", Shader::VERTEX);
 	forward_lights.add("shaders/forward-lights.f.glsl", Shader::FRAGMENT);
@@ -196,28 +395,54 @@ int main(int argc, char ** argv) {
 	forward_lights.use();
 
 	auto uForwardLightsWorld = forward_lights.getUniform("world", Shader::MANDITORY);
-	auto uForwardLightsView = forward_lights.getUniform("view", Shader::MANDITORY);
-	auto uForwardLightsProjection = forward_lights.getUniform("projection", Shader::MANDITORY);
+	auto uForwardLightsPositionScale = forward_lights.getUniform("positionScale", Shader::MANDITORY);
+	auto uForwardLightsPositionBias = forward_lights.getUniform("positionBias", Shader::MANDITORY);
+	glUniform1i(forward_lights.getUniform("octNormals", Shader::MANDITORY), packed_vertices);
 	auto uForwardLightsLightPosition = forward_lights.getUniform("lightposition", Shader::MANDITORY);
 	auto uForwardLightsLightColor = forward_lights.getUniform("lightcolor", Shader::MANDITORY);
 	auto uForwardLightsRadius = forward_lights.getUniform("radius", Shader::MANDITORY);
-	
-	glUniformMatrix4fv(uForwardLightsProjection, 1, GL_FALSE, glm::value_ptr(projection));
+
+	// Clustered forward reads its light lists through texture buffer ranges of the stream buffers
+	bool clustered_supported = GLEW_VERSION_4_3 || (GLEW_ARB_texture_buffer_range && GLEW_ARB_texture_buffer_object_rgb32);
+
+	Shader_Program forward_clustered;
+	forward_clustered.add("shaders/geometry.v.glsl", Shader::VERTEX);
+	forward_clustered.add("shaders/forward-clustered.f.glsl", Shader::FRAGMENT);
+	forward_clustered.compile();
+	forward_clustered.link();
+	forward_clustered.use();
+
+	auto uForwardClusteredWorld = forward_clustered.getUniform("world", Shader::MANDITORY);
+	auto uForwardClusteredPositionScale = forward_clustered.getUniform("positionScale", Shader::MANDITORY);
+	auto uForwardClusteredPositionBias = forward_clustered.getUniform("positionBias", Shader::MANDITORY);
+	glUniform1i(forward_clustered.getUniform("octNormals", Shader::MANDITORY), packed_vertices);
+	auto uForwardClusteredGridSize = forward_clustered.getUniform("gridSize", Shader::MANDITORY);
+	auto uForwardClusteredSliceScale = forward_clustered.getUniform("sliceScale", Shader::MANDITORY);
+	auto uForwardClusteredSliceBias = forward_clustered.getUniform("sliceBias", Shader::MANDITORY);
+	glUniform1f(forward_clustered.getUniform("tileSize", Shader::MANDITORY), Light_Clusters::tile_size);
+	glUniform1i(forward_clustered.getUniform("sliceCount", Shader::MANDITORY), Light_Clusters::depth_slices);
+	glUniform1i(forward_clustered.getUniform("clusters"), 7);
+	glUniform1i(forward_clustered.getUniform("lightIndices"), 8);
+	glUniform1i(forward_clustered.getUniform("lightPositions"), 9);
+	glUniform1i(forward_clustered.getUniform("lightColors"), 10);
 
 	Shader_Program ssaoPass1;
+	DefineGBufferLayout(ssaoPass1);
 	ssaoPass1.add("shaders/lighting.v.glsl", Shader::VERTEX);
 	ssaoPass1.add("shaders/ssao-pass1.f.glsl", Shader::FRAGMENT);
 	ssaoPass1.compile();
 	ssaoPass1.link();
 	ssaoPass1.use();
 
-	glUniform1i(ssaoPass1.getUniform("gPositionDepth"), 0);
+	glUniform1i(ssaoPass1.getUniform("gPosition"), 0);
 	glUniform1i(ssaoPass1.getUniform("gNormal"), 1);
 	glUniform1i(ssaoPass1.getUniform("gDepth"), 6);
 	glUniform1i(ssaoPass1.getUniform("texNoise"), 3);
 
 	auto uSSAOPass1Samples = ssaoPass1.getUniform("samples", Shader::MANDITORY);
-	auto uSSAOPass1Projection = ssaoPass1.getUniform("projection", Shader::MANDITORY);
+	auto uSSAOPass1SampleOffset = ssaoPass1.getUniform("sampleOffset", Shader::MANDITORY);
+	auto uSSAOPass1SampleCount = ssaoPass1.getUniform("sampleCount", Shader::MANDITORY);
+	auto uSSAOPass1RawOcclusion = ssaoPass1.getUniform("rawOcclusion", Shader::MANDITORY);
 
 	Shader_Program ssaoPass2;
 	ssaoPass2.add("shaders/lighting.v.glsl", Shader::VERTEX);
@@ -228,6 +453,54 @@ int main(int argc, char ** argv) {
 
 	glUniform1i(ssaoPass2.getUniform("ssaoInput", Shader::MANDITORY), 4);
 
+	// Half and quarter resolution SSAO: separable depth aware blur, then a bilateral upsample
+	Shader_Program ssaoBlur;
+	ssaoBlur.add("shaders/lighting.v.glsl", Shader::VERTEX);
+	ssaoBlur.add("shaders/ssao-blur.f.glsl", Shader::FRAGMENT);
+	ssaoBlur.compile();
+	ssaoBlur.link();
+	ssaoBlur.use();
+
+	auto uSSAOBlurInput = ssaoBlur.getUniform("ssaoInput", Shader::MANDITORY);
+	auto uSSAOBlurDirection = ssaoBlur.getUniform("direction", Shader::MANDITORY);
+	glUniform1i(ssaoBlur.getUniform("ssaoDepth", Shader::MANDITORY), 14);
+
+	Shader_Program ssaoUpsample;
+	ssaoUpsample.add("shaders/lighting.v.glsl", Shader::VERTEX);
+	ssaoUpsample.add("shaders/ssao-upsample.f.glsl", Shader::FRAGMENT);
+	ssaoUpsample.compile();
+	ssaoUpsample.link();
+	ssaoUpsample.use();
+
+	glUniform1i(ssaoUpsample.getUniform("ssaoInput", Shader::MANDITORY), 13);
+	glUniform1i(ssaoUpsample.getUniform("ssaoDepth", Shader::MANDITORY), 14);
+	glUniform1i(ssaoUpsample.getUniform("gDepth", Shader::MANDITORY), 6);
+
+	// Temporal SSAO: a few samples a frame, accumulated through reprojection
+	Shader_Program ssaoTemporal;
+	DefineGBufferLayout(ssaoTemporal);
+	ssaoTemporal.add("shaders/lighting.v.glsl", Shader::VERTEX);
+	ssaoTemporal.add("shaders/ssao-temporal.f.glsl", Shader::FRAGMENT);
+	ssaoTemporal.compile();
+	ssaoTemporal.link();
+	ssaoTemporal.use();
+
+	auto uSSAOTemporalReprojection = ssaoTemporal.getUniform("reprojection", Shader::MANDITORY);
+	glUniform1i(ssaoTemporal.getUniform("gPosition"), 0);
+	glUniform1i(ssaoTemporal.getUniform("gDepth", Shader::MANDITORY), 6);
+	glUniform1i(ssaoTemporal.getUniform("ssaoInput", Shader::MANDITORY), 4);
+	glUniform1i(ssaoTemporal.getUniform("previousHistory", Shader::MANDITORY), 15);
+
+	// View, projection and the rest come from the Frame block, written once a frame
+	std::vector<Shader_Program*> frame_readers = {&geometrypass, &lightingpass, &lightbound, &lightinstanced, &drawlights,
+	                                              &forward_sun, &forward_lights, &forward_clustered, &ssaoPass1, &ssaoTemporal};
+	if (tiled_supported) {
+		frame_readers.push_back(&lighttiled);
+	}
+	for (Shader_Program* program : frame_readers) {
+		program->bindUniformBlock("Frame", FrameBlockBinding);
+	}
+
 	Shader_Program hdr_pass;
 
 	hdr_pass.add("shaders/lighting.v.glsl", Shader::VERTEX);
@@ -239,43 +512,83 @@ int main(int argc, char ** argv) {
 	glUniform1i(hdr_pass.getUniform("inval", Shader::MANDITORY), 0);
 
 	auto uHDRExposure = hdr_pass.getUniform("exposure");
+	auto uHDRGpuExposure = hdr_pass.getUniform("gpuExposure");
+	glUniform1i(hdr_pass.getUniform("exposureTexture"), 1);
+
+	// Exposure from a luminance histogram, computed and applied without leaving the GPU.
+	// Without compute shaders the mipmapped average is read back instead.
+	bool gpu_exposure_supported = GLEW_VERSION_4_3;
+	constexpr float MinLogLuminance = -10.0f;
+	constexpr float LogLuminanceRange = 16.0f;
+	Shader_Program luminance_histogram, exposure_adapt;
+	GLuint uExposureAdaptDeltaTime = 0;
+	GLuint Luminance_Histogram_SSBO = 0, Exposure_Texture = 0;
+	if (gpu_exposure_supported) {
+		luminance_histogram.add("shaders/luminance-histogram.c.glsl", Shader::COMPUTE);
+		luminance_histogram.compile();
+		luminance_histogram.link();
+		luminance_histogram.use();
+
+		glUniform1i(luminance_histogram.getUniform("hdrColor", Shader::MANDITORY), 0);
+		glUniform1f(luminance_histogram.getUniform("minLogLum", Shader::MANDITORY), MinLogLuminance);
+		glUniform1f(luminance_histogram.getUniform("logLumRange", Shader::MANDITORY), LogLuminanceRange);
+
+		exposure_adapt.add("shaders/exposure-adapt.c.glsl", Shader::COMPUTE);
+		exposure_adapt.compile();
+		exposure_adapt.link();
+		exposure_adapt.use();
+
+		glUniform1f(exposure_adapt.getUniform("minLogLum", Shader::MANDITORY), MinLogLuminance);
+		glUniform1f(exposure_adapt.getUniform("logLumRange", Shader::MANDITORY), LogLuminanceRange);
+		// Ignore the darkest 10% and the brightest 5%
+		glUniform1f(exposure_adapt.getUniform("lowPercent", Shader::MANDITORY), 0.1f);
+		glUniform1f(exposure_adapt.getUniform("highPercent", Shader::MANDITORY), 0.95f);
+		uExposureAdaptDeltaTime = exposure_adapt.getUniform("deltaTime", Shader::MANDITORY);
+
+		// The adapt pass zeroes the histogram after reading it, so it only needs clearing once
+		std::vector<GLuint> zeros(64, 0);
+		glGenBuffers(1, &Luminance_Histogram_SSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, Luminance_Histogram_SSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, zeros.size() * sizeof(GLuint), zeros.data(), GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+		float start_exposure = 1.0f;
+		glGenTextures(1, &Exposure_Texture);
+		glBindTexture(GL_TEXTURE_2D, Exposure_Texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, 1, 1, 0, GL_RED, GL_FLOAT, &start_exposure);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
 
 	///////////////////////
 	// Vertex Array Prep //
 	///////////////////////
 
-	GLuint Monkey_VAO, Monkey_VBO;
+	GLuint Monkey_VAO, Monkey_VBO, Monkey_EBO;
 	glGenVertexArrays(1, &Monkey_VAO);
 	glBindVertexArray(Monkey_VAO);
 
 	glGenBuffers(1, &Monkey_VBO);
 	glBindBuffer(GL_ARRAY_BUFFER, Monkey_VBO);
-	glBufferData(GL_ARRAY_BUFFER, file.objects[0].vertices.size() * sizeof(Vertex), file.objects[0].vertices.data(), GL_STATIC_DRAW);
+	auto monkey_transform = UploadVertices(file.objects[0], packed_vertices);
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*) (0 * sizeof(GLfloat))); // Position
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*) (3 * sizeof(GLfloat))); // Texcoords
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*) (5 * sizeof(GLfloat))); // Normals
-	
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
+	glGenBuffers(1, &Monkey_EBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Monkey_EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, file.objects[0].index_count * file.objects[0].index_size, file.objects[0].indices, GL_STATIC_DRAW);
 
 	// World
-	GLuint World_VAO, World_VBO;
+	GLuint World_VAO, World_VBO, World_EBO;
 	glGenVertexArrays(1, &World_VAO);
 	glBindVertexArray(World_VAO);
 
 	glGenBuffers(1, &World_VBO);
 	glBindBuffer(GL_ARRAY_BUFFER, World_VBO);
-	glBufferData(GL_ARRAY_BUFFER, worldfile.objects[0].vertices.size() * sizeof(Vertex), worldfile.objects[0].vertices.data(), GL_STATIC_DRAW);
+	auto world_transform = UploadVertices(worldfile.objects[0], packed_vertices);
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*) (0 * sizeof(GLfloat))); // Position
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*) (3 * sizeof(GLfloat))); // Texcoords
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*) (5 * sizeof(GLfloat))); // Normals
-	
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
+	glGenBuffers(1, &World_EBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, World_EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, worldfile.objects[0].index_count * worldfile.objects[0].index_size, worldfile.objects[0].indices, GL_STATIC_DRAW);
 
 	glBindVertexArray(0);
 
@@ -283,26 +596,11 @@ int main(int argc, char ** argv) {
 	// Lights //
 	////////////
 
-	size_t lightcount = 0;
-
-	struct LightData {
-		float distance;
-		float orbit;
-		float height;
-		float size;
-	};
-
-	std::vector<LightData> lightdata;
-	std::vector<glm::vec3> lightposition;
-	std::vector<glm::mat4> lightworldmatrix;
-	std::vector<glm::mat4> lighteffectworldmatrix;
-	std::vector<glm::vec3> lightcolor;
-
-	lightdata.reserve(lightcount);
-	lightposition.reserve(lightcount);
-	lightworldmatrix.reserve(lightcount);
-	lighteffectworldmatrix.reserve(lightcount);
-	lightcolor.reserve(lightcount);
+	Job_System jobs;
+	Light_System lights;
+	Light_Clusters clusters;
+	std::vector<glm::vec4> cluster_light_positions;
+	std::cerr << "Light transforms using the " << Light_System::kernel_name(lights.get_kernel()) << " kernel on " << jobs.thread_count() << " threads.\n";
 
 	// Color
 	std::uniform_real_distribution<float> color_distribution(0, 1);
@@ -315,44 +613,31 @@ int main(int argc, char ** argv) {
 
 	auto create_single_light = [&] {
 		// Color
-		lightcolor.emplace_back(glm::normalize(glm::vec3(color_distribution(prng), color_distribution(prng), color_distribution(prng))) * intensity_distribution(prng));
+		auto color = glm::normalize(glm::vec3(color_distribution(prng), color_distribution(prng), color_distribution(prng))) * intensity_distribution(prng);
 
 		// Position
-		auto&& colorit = lightcolor.end() - 1;
-		LightData ret;
-		ret.distance = position_dist_distribution(prng);
-		ret.orbit = position_orbit_distribution(prng);
-		ret.height = position_height_distribution(prng);
-		constexpr float constant = 1.0;
-		constexpr float linear = 0.7;
-		constexpr float quadratic = 1.8;
-		float lightMax = std::max(std::max(colorit->r, colorit->g), colorit->b);
-		ret.size = (-linear + std::sqrt(linear * linear - 4 * quadratic * (constant - (256.0 / 5.0) * lightMax))) / (2 * quadratic);
-		lightdata.push_back(std::move(ret));
-
-		lightposition.emplace_back();
-		lightworldmatrix.emplace_back();
-		lighteffectworldmatrix.emplace_back();
-
-		lightcount += 1;
+		float distance = position_dist_distribution(prng);
+		float orbit = position_orbit_distribution(prng);
+		float height = position_height_distribution(prng);
+
+		lights.add(distance, orbit, height, color);
 	};
 
+	// Colors only change with the light count, so they're uploaded then
+	bool light_colors_dirty = true;
+
 	auto create_light = [&](size_t count = 10) {
 		for (size_t i = 0; i < count; ++i) {
 			create_single_light();
 		}
+		light_colors_dirty = true;
 
-		std::cerr << count << " lights added. " << lightcount << " total.\n";
+		std::cerr << count << " lights added. " << lights.count() << " total.\n";
 	};
 
 	auto remove_single_light = [&] {
-		if (lightcount) {
-			lightdata.pop_back();
-			lightposition.pop_back();
-			lightworldmatrix.pop_back();
-			lighteffectworldmatrix.pop_back();
-			lightcolor.pop_back();
-			lightcount -= 1;
+		if (lights.count()) {
+			lights.pop_back();
 		}
 		else {
 			std::cerr << "Dammit you, there are no more lights left!\n";
@@ -363,35 +648,46 @@ int main(int argc, char ** argv) {
 		for (size_t i = 0; i < count; ++i) {
 			remove_single_light();
 		}
+		light_colors_dirty = true;
+
+		std::cerr << count << " lights removed. " << lights.count() << " total.\n";
+	};
 
-		std::cerr << count << " lights removed. " << lightcount << " total.\n";
+	auto set_light_count = [&](size_t count) {
+		if (count > lights.count()) {
+			create_light(count - lights.count());
+		}
+		else if (count < lights.count()) {
+			remove_light(lights.count() - count);
+		}
 	};
 
 	create_light(20);
 
-	auto circlefile = parse_obj_file("sphere.wavobj");
-	auto squarefile = parse_obj_file("square.wavobj");
+	auto circlefile = load_mesh("sphere.wavobj");
+	auto squarefile = load_mesh("square.wavobj");
 
-	GLuint Light_VAO, Light_VBO;
-	GLuint LightCircle_VBO;
-	GLuint LightTransform_VBO;
+	GLuint Light_VAO, Light_VBO, Light_EBO;
+	GLuint LightCircle_VBO, LightCircle_EBO;
 	GLuint LightColor_VBO;
-	GLuint LightPosition_VBO;
+	Stream_Buffer LightSprite_Stream(GL_ARRAY_BUFFER);
+	Stream_Buffer LightVolume_Stream(GL_ARRAY_BUFFER);
+	Stream_Buffer LightPosition_Stream(GL_ARRAY_BUFFER);
 	glGenVertexArrays(1, &Light_VAO);
 	glBindVertexArray(Light_VAO);
 
 	glGenBuffers(1, &Light_VBO);
 	glBindBuffer(GL_ARRAY_BUFFER, Light_VBO);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), NULL);
-	glBufferData(GL_ARRAY_BUFFER, squarefile.objects[0].vertices.size() * sizeof(Vertex), squarefile.objects[0].vertices.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, squarefile.objects[0].vertex_count * sizeof(Vertex), squarefile.objects[0].vertices, GL_STATIC_DRAW);
 	glEnableVertexAttribArray(0);
 
-	glGenBuffers(1, &LightTransform_VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, LightTransform_VBO);
-	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*) (0 * sizeof(GLfloat)));
-	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*) (4 * sizeof(GLfloat)));
-	glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*) (8 * sizeof(GLfloat)));
-	glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*) (12 * sizeof(GLfloat)));
+	// The square and sphere share this VAO, so their index buffers are rebound before drawing
+	glGenBuffers(1, &Light_EBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Light_EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, squarefile.objects[0].index_count * squarefile.objects[0].index_size, squarefile.objects[0].indices, GL_STATIC_DRAW);
+
+	// Per frame instance data is streamed, its attribute pointers are set every frame
 	glEnableVertexAttribArray(2);
 	glEnableVertexAttribArray(3);
 	glEnableVertexAttribArray(4);
@@ -407,26 +703,58 @@ int main(int argc, char ** argv) {
 	glEnableVertexAttribArray(1);
 	glVertexAttribDivisor(1, 1);
 
-	glGenBuffers(1, &LightPosition_VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, LightPosition_VBO);
-	glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), NULL);
 	glEnableVertexAttribArray(6);
 	glVertexAttribDivisor(6, 1);
 
 	glGenBuffers(1, &LightCircle_VBO);
 	glBindBuffer(GL_ARRAY_BUFFER, LightCircle_VBO);
-	glBufferData(GL_ARRAY_BUFFER, circlefile.objects[0].vertices.size() * sizeof(Vertex), circlefile.objects[0].vertices.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, circlefile.objects[0].vertex_count * sizeof(Vertex), circlefile.objects[0].vertices, GL_STATIC_DRAW);
 	glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), NULL);
+
+	glGenBuffers(1, &LightCircle_EBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, LightCircle_EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, circlefile.objects[0].index_count * circlefile.objects[0].index_size, circlefile.objects[0].indices, GL_STATIC_DRAW);
 	
 	glBindVertexArray(0);
 
+	// Clustered forward light lists, rewritten every frame
+	Stream_Buffer ClusterGrid_Stream(GL_TEXTURE_BUFFER);
+	Stream_Buffer ClusterIndex_Stream(GL_TEXTURE_BUFFER);
+	GLuint ClusterGrid_TBO, ClusterIndex_TBO, LightPosition_TBO, LightColor_TBO;
+	glGenTextures(1, &ClusterGrid_TBO);
+	glGenTextures(1, &ClusterIndex_TBO);
+	glGenTextures(1, &LightPosition_TBO);
+	glGenTextures(1, &LightColor_TBO);
+
+	// Average scene color for auto exposure, read back a couple of frames late instead of stalling
+	Readback_Buffer Exposure_Readback(sizeof(glm::vec3));
+	// The GPU's adapted exposure, only read when switching to manual so it starts where auto left off
+	Readback_Buffer Exposure_Value_Readback(sizeof(float));
+
 	/////////////////////
 	// Prepare gBuffer //
 	/////////////////////
 
 	RenderInfo reninfo;
+	reninfo.compactGBuffer = compact_gbuffer;
+	// Volumes sample gDepth while testing against it, which is only defined after a texture barrier
+	bool texture_barrier_supported = GLEW_VERSION_4_5 || GLEW_ARB_texture_barrier;
+	if (!depth_blits && !texture_barrier_supported) {
+		std::cerr << "No texture barriers, depth is blitted to the light buffer.\n";
+	}
+	reninfo.sharedDepth = !depth_blits && texture_barrier_supported;
+	reninfo.ssaoScale = ssao_scale;
+	reninfo.ssaoTemporal = ssao_temporal;
 	PrepareBuffers(WINDOW_WIDTH, WINDOW_HEIGHT, reninfo);
 
+	// Bytes moved by each full screen write or read of the G-buffer
+	for (bool compact : {true, false}) {
+		size_t bytes = GBufferBytesPerPixel(compact);
+		std::cerr << (compact == compact_gbuffer ? "* " : "  ") << (compact ? "Compact" : "Fat") << " G-buffer: " << bytes
+		          << " bytes/pixel, " << bytes * 1920 * 1080 / 1e6 << " MB at 1080p, " << bytes * 3840 * 2160 / 1e6
+		          << " MB at 4K\n";
+	}
+
 	//////////////////////
 	// SSAO Sample Prep //
 	//////////////////////
@@ -469,15 +797,38 @@ int main(int argc, char ** argv) {
 	// Game Loop //
 	///////////////
 
-	bool forward = false;
+	Render_Mode mode = Render_Mode::deferred;
+	if (bench_mode == "tiled" && tiled_supported) {
+		mode = Render_Mode::tiled;
+	}
+	else if (bench_mode == "clustered" && clustered_supported) {
+		mode = Render_Mode::clustered;
+	}
+	else if (bench_mode == "forward") {
+		mode = Render_Mode::forward;
+	}
+	else if (!bench_mode.empty() && bench_mode != "deferred") {
+		std::cerr << "Render mode " << bench_mode << " is unknown or unsupported\n";
+		throw std::runtime_error("Unsupported render mode");
+	}
+	bool tile_heatmap = false;
 	bool SSAO = true;
 	bool dynamic_lighting = true;
+	bool instanced_volumes = true;
 	bool loop = true;
 	bool fullscreen = false, gotmouse = true;
 	std::unordered_map<SDL_Keycode, bool> keys;
 	float exposure = 1.0;
-
-	SDL_SetRelativeMouseMode(SDL_TRUE);
+	float luminosity = 0.4; // Steady state for the starting exposure
+	bool manual_exposure = false;
+	// Switching to manual reads the GPU's exposure back, which lands a couple of frames later.
+	// Changes made in the meantime are kept relative to the value at the switch.
+	bool exposure_seed_pending = false;
+	float exposure_seed_base = 0;
+
+	if (!headless) {
+		SDL_SetRelativeMouseMode(SDL_TRUE);
+	}
 
 	float mouseX = 0, mouseY = 0;
 	float mouseLX = 0, mouseLY = 0;
@@ -488,14 +839,69 @@ int main(int argc, char ** argv) {
 	FPS_Meter fps(true, 2);
 	Camera cam(glm::vec3(0, 10, 25));
 	cam.set_rotation(30, 0);
+
+	Profiler profiler;
+
+	GL_State gl;
+
+	// Resources the passes hand each other, the graph only needs their names
+	Renderer renderer(gl);
+	Renderer::Resource r_lights       = renderer.resource("lights");
+	Renderer::Resource r_gbuffer      = renderer.resource("gbuffer");
+	Renderer::Resource r_depth_copies = renderer.resource("depth copies");
+	Renderer::Resource r_ssao         = renderer.resource("ssao");
+	Renderer::Resource r_scene        = renderer.resource("scene");
+	Renderer::Resource r_backbuffer   = renderer.resource("backbuffer");
+	renderer.output(r_backbuffer);
+
+	// The passes only change with these settings and the framebuffers, and the graph is rebuilt when they do.
+	// Anything the passes capture has to live outside the loop, as they run every frame until then.
+	using Graph_Settings = std::tuple<Render_Mode, bool, bool, bool>; // Mode, SSAO, dynamic lighting, instanced volumes
+	Graph_Settings graph_settings;
+	float delta_time = 0;
+	bool clustered = false, draw_volumes_instanced = false;
+
+	// One Frame_Constants a frame, bound for every program at FrameBlockBinding
+	Stream_Buffer Frame_Stream(GL_UNIFORM_BUFFER);
+	float elapsed_time = 0;
+
+	size_t bench_frame = 0;
+	std::ofstream bench_out;
+	if (headless) {
+		bench_out.open(bench_csv);
+		if (!bench_out) {
+			std::cerr << "Can't open " << bench_csv << " for writing\n";
+			throw std::runtime_error("Benchmark output failed");
+		}
+	}
 		
 	///////////////
 	// Game Loop //
 	///////////////
 
 	while (loop) {
-		int mousePixelX, mousePixelY;
-		SDL_GetRelativeMouseState(&mousePixelX, &mousePixelY);
+		auto frame_start = std::chrono::steady_clock::now();
+
+		if (headless) {
+			// Every light count gets the same orbit around the monkey
+			size_t step = bench_frame / bench_frames;
+			if (step == bench_lights.size()) {
+				break;
+			}
+			size_t frame = bench_frame % bench_frames;
+			if (frame == 0) {
+				set_light_count(bench_lights[step]);
+			}
+
+			float angle = 2 * 3.14159265f * frame / bench_frames;
+			cam.set_location(glm::vec3(25 * std::sin(angle), 10, 25 * std::cos(angle)));
+			cam.set_rotation(20, -glm::degrees(angle));
+		}
+
+		int mousePixelX = 0, mousePixelY = 0;
+		if (!headless) {
+			SDL_GetRelativeMouseState(&mousePixelX, &mousePixelY);
+		}
 
 		mouseDX = (mousePixelX / (float) sdlm.size.height);
 		mouseDY = (mousePixelY / (float) sdlm.size.height);
@@ -510,21 +916,26 @@ int main(int argc, char ** argv) {
 			cam.rotate(mouseDY, mouseDX, 50);
 		}
 
-		fps.frame(lightcount);
+		fps.frame(lights.count());
 
-		const float cameraSpeed = 5.0f * fps.get_delta_time();
+		// Benchmarks step a fixed time per frame so runs animate the same on any machine
+		delta_time = headless ? 1.0f / 60 : fps.get_delta_time();
+		elapsed_time += delta_time;
+		const float cameraSpeed = 5.0f * delta_time;
 
 		// Event Handling
 		SDL_Event event;
+		// A window drag sends many size changes a frame, only the last one is worth reallocating for
+		bool resized = false;
 
-		while (SDL_PollEvent(&event)) {
+		while (!headless && SDL_PollEvent(&event)) {
 			switch (event.type) {
 				case SDL_QUIT:
 					loop = false;
 					break;
 				case SDL_WINDOWEVENT:
 					if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
-						projection = Resize(sdlm, reninfo);
+						resized = true;
 					}
 					break;
 				case SDL_KEYDOWN:
@@ -543,7 +954,7 @@ int main(int argc, char ** argv) {
 							}
 							break;
 						case SDLK_0:
-							remove_light(lightcount);
+							remove_light(lights.count());
 							break;
 						case SDLK_RIGHTBRACKET:
 							create_light(10);
@@ -557,6 +968,25 @@ int main(int argc, char ** argv) {
 						case SDLK_MINUS:
 							remove_light(1);
 							break;
+						case SDLK_1:
+							set_light_count(100);
+							break;
+						case SDLK_2:
+							set_light_count(1000);
+							break;
+						case SDLK_3:
+							set_light_count(10000);
+							break;
+						case SDLK_v:
+							if (instanced_volumes) {
+								std::cerr << "Using per light stencil volumes.\n";
+								instanced_volumes = false;
+							}
+							else {
+								std::cerr << "Using instanced light volumes.\n";
+								instanced_volumes = true;
+							}
+							break;
 						case SDLK_LALT:
 						case SDLK_RALT:
 							if (gotmouse) {
@@ -568,13 +998,71 @@ int main(int argc, char ** argv) {
 							gotmouse = !gotmouse;
 							break;
 						case SDLK_m:
-							if (forward) {
+							// Deferred -> tiled -> clustered -> forward, skipping what the driver can't do
+							if (mode == Render_Mode::deferred && tiled_supported) {
+								std::cerr << "Enabling tiled deferred rendering.\n";
+								mode = Render_Mode::tiled;
+							}
+							else if ((mode == Render_Mode::deferred || mode == Render_Mode::tiled) && clustered_supported) {
+								std::cerr << "Enabling clustered forward rendering.\n";
+								mode = Render_Mode::clustered;
+							}
+							else if (mode != Render_Mode::forward) {
+								std::cerr << "Enabling forward rendering.\n";
+								mode = Render_Mode::forward;
+							}
+							else {
 								std::cerr << "Enabling deferred rendering.\n";
-								forward = false;
+								mode = Render_Mode::deferred;
+							}
+							break;
+						case SDLK_e:
+							if (manual_exposure) {
+								std::cerr << "Automatic exposure.\n";
+								manual_exposure = false;
+								exposure_seed_pending = false;
+								if (gpu_exposure_supported) {
+									// Adapt from the manual value rather than where the GPU left off
+									gl.bind_texture(1, GL_TEXTURE_2D, Exposure_Texture);
+									glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RED, GL_FLOAT, &exposure);
+								}
+							}
+							break;
+						case SDLK_p:
+							profiler.write_trace(trace_file);
+							renderer.print(std::cout);
+							break;
+						case SDLK_o:
+							// Full -> half -> quarter resolution -> temporal SSAO
+							DeleteBuffers(reninfo);
+							if (reninfo.ssaoTemporal) {
+								reninfo.ssaoTemporal = false;
+							}
+							else if (reninfo.ssaoScale == 4) {
+								reninfo.ssaoScale = 1;
+								reninfo.ssaoTemporal = true;
 							}
 							else {
-								std::cerr << "Enabling forward rendering.\n";
-								forward = true;
+								reninfo.ssaoScale *= 2;
+							}
+							PrepareBuffers(sdlm.size.width, sdlm.size.height, reninfo);
+							gl.invalidate();
+							renderer.clear();
+							if (reninfo.ssaoTemporal) {
+								std::cerr << "Temporal SSAO.\n";
+							}
+							else {
+								std::cerr << "SSAO at 1/" << reninfo.ssaoScale << " resolution.\n";
+							}
+							break;
+						case SDLK_t:
+							if (tile_heatmap) {
+								std::cerr << "Disabling tile heatmap.\n";
+								tile_heatmap = false;
+							}
+							else {
+								std::cerr << "Enabling tile heatmap.\n";
+								tile_heatmap = true;
 							}
 							break;
 						case SDLK_n:
@@ -608,6 +1096,12 @@ int main(int argc, char ** argv) {
 			}
 		}
 
+		if (resized) {
+			projection = Resize(sdlm, reninfo);
+			gl.invalidate();
+			renderer.clear();
+		}
+
 		if (keys[SDLK_w]) {
 			cam.move(glm::vec3(0, 0, cameraSpeed));
 		}
@@ -626,6 +1120,24 @@ int main(int argc, char ** argv) {
 		if (keys[SDLK_LCTRL]) {
 			cam.move(glm::vec3(0, -cameraSpeed, 0));
 		}
+		// N toggles SSAO, so exposure goes down on J
+		if (keys[SDLK_h] || keys[SDLK_j]) {
+			if (!manual_exposure) {
+				std::cerr << "Manual exposure, E returns to automatic.\n";
+				manual_exposure = true;
+				if (gpu_exposure_supported) {
+					gl.bind_texture(1, GL_TEXTURE_2D, Exposure_Texture);
+					Exposure_Value_Readback.get_tex_image(GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT);
+					exposure_seed_pending = true;
+					exposure_seed_base = exposure;
+				}
+			}
+		}
+		float gpu_exposure_value;
+		if (exposure_seed_pending && Exposure_Value_Readback.latest(&gpu_exposure_value)) {
+			exposure = gpu_exposure_value + (exposure - exposure_seed_base);
+			exposure_seed_pending = false;
+		}
 		if (keys[SDLK_h]) {
 			float old = std::floor(exposure * 4);
 			exposure += 0.01;
@@ -633,7 +1145,7 @@ int main(int argc, char ** argv) {
 				std::cerr << "Exposure = " << exposure << '\n';
 			}
 		}
-		if (keys[SDLK_n]) {
+		if (keys[SDLK_j]) {
 			float old = std::floor(exposure * 4);
 			exposure -= 0.01;
 			if (old > std::floor(exposure * 4)) {
@@ -641,382 +1153,671 @@ int main(int argc, char ** argv) {
 			}
 		}
 
-		// Update Light Transforms
-		for (size_t i = 0; i < lightcount; ++i) {
-			auto&& lp = lightdata[i];
-			lp.orbit += glm::radians(15.0f * fps.get_delta_time());
-
-			glm::mat4 height = glm::translate(glm::mat4(), glm::vec3(0, lp.height, 0));
-			glm::mat4 orbit = glm::rotate(glm::mat4(), lp.orbit, glm::vec3(0, 1, 0));
-			glm::mat4 trans = glm::translate(glm::mat4(), glm::vec3(0, 0, -lp.distance));
-			glm::mat4 scale = glm::scale(glm::mat4(), glm::vec3(lp.size * 0.04));
-			glm::mat4 effectscale = glm::scale(glm::mat4(), glm::vec3(lp.size));
-
-			glm::mat4 unscaled = orbit * height * trans;
-			lightposition[i] = glm::vec3(cam.get_matrix() * unscaled * glm::vec4(0, 0, 0, 1));
-			lightworldmatrix[i] = unscaled * scale;
-			lighteffectworldmatrix[i] = unscaled * effectscale;
+		// Frame Constants, written once into this frame's region of the stream
+		auto frame_constants = static_cast<Frame_Constants*>(Frame_Stream.map(sizeof(Frame_Constants)));
+		frame_constants->view = cam.get_matrix();
+		frame_constants->projection = projection;
+		frame_constants->inverse_projection = glm::inverse(projection);
+		frame_constants->view_position = cam.get_location();
+		frame_constants->time = elapsed_time;
+		frame_constants->resolution = glm::vec2(sdlm.size.width, sdlm.size.height);
+		Frame_Stream.unmap();
+		glBindBufferRange(GL_UNIFORM_BUFFER, FrameBlockBinding, Frame_Stream.get_buffer(), Frame_Stream.offset(), sizeof(Frame_Constants));
+
+		Graph_Settings settings(mode, SSAO, dynamic_lighting, instanced_volumes);
+		if (settings != graph_settings) {
+			graph_settings = settings;
+			renderer.clear();
 		}
+		clustered = mode == Render_Mode::clustered;
+		draw_volumes_instanced = mode == Render_Mode::deferred && dynamic_lighting && instanced_volumes;
+
+		// Built on the first frame, and again after a settings change or a framebuffer rebuild clears it
+		if (renderer.empty()) {
+			// Light Transforms, written straight into this frame's region of the instance streams
+			renderer.add_pass("lights", Renderer::no_framebuffer, {}, {r_lights}, [&] {
+				Light_Targets light_targets;
+				if (clustered) {
+					// Binning reads the positions back, which is slow from write combined GPU memory
+					cluster_light_positions.resize(lights.count());
+					light_targets.view_positions = cluster_light_positions.data();
+				}
+				else {
+					light_targets.view_positions = static_cast<glm::vec4*>(LightPosition_Stream.map(lights.count() * sizeof(glm::vec4)));
+				}
+				light_targets.sprite_matrices = static_cast<glm::mat4*>(LightSprite_Stream.map(lights.count() * sizeof(glm::mat4)));
+				if (draw_volumes_instanced) {
+					light_targets.volume_matrices = static_cast<glm::mat4*>(LightVolume_Stream.map(lights.count() * sizeof(glm::mat4)));
+				}
 
-		glBindVertexArray(Light_VAO);
-		glBindBuffer(GL_ARRAY_BUFFER, LightTransform_VBO);
-		glBufferData(GL_ARRAY_BUFFER, lightcount * sizeof(glm::mat4), lighteffectworldmatrix.data(), GL_STREAM_DRAW);
+				lights.update(glm::radians(15.0f * delta_time), cam.get_matrix(), light_targets, &jobs);
 
-		glBindBuffer(GL_ARRAY_BUFFER, LightPosition_VBO);
-		glBufferData(GL_ARRAY_BUFFER, lightcount * sizeof(glm::vec3), lightposition.data(), GL_STREAM_DRAW);
+				if (clustered) {
+					size_t cluster_lights = dynamic_lighting ? lights.count() : 0;
+					clusters.build(cluster_light_positions.data(), cluster_lights, projection, NearPlane, FarPlane, sdlm.size.width, sdlm.size.height, &jobs);
 
-		glBindBuffer(GL_ARRAY_BUFFER, LightColor_VBO);
-		glBufferData(GL_ARRAY_BUFFER, lightcount * sizeof(glm::vec3), lightcolor.data(), GL_STREAM_DRAW);
+					auto& grid = clusters.get_clusters();
+					auto& indices = clusters.get_indices();
+					void* positions = LightPosition_Stream.map(cluster_lights * sizeof(glm::vec4));
+					if (positions) {
+						std::copy(cluster_light_positions.begin(), cluster_light_positions.begin() + cluster_lights, static_cast<glm::vec4*>(positions));
+					}
+					std::copy(grid.begin(), grid.end(), static_cast<glm::uvec2*>(ClusterGrid_Stream.map(grid.size() * sizeof(glm::uvec2))));
+					void* index_ptr = ClusterIndex_Stream.map(indices.size() * sizeof(std::uint32_t));
+					if (index_ptr) {
+						std::copy(indices.begin(), indices.end(), static_cast<std::uint32_t*>(index_ptr));
+					}
+					ClusterGrid_Stream.unmap();
+					ClusterIndex_Stream.unmap();
+				}
 
-		if (!forward) {
-			///////////////////
-			// Geometry Pass //
-			///////////////////
-			
-			// Use geometry pass shaders
-			geometrypass.use();
+				LightPosition_Stream.unmap();
+				LightSprite_Stream.unmap();
+				LightVolume_Stream.unmap();
+				// Mapping binds the streams' buffers
+				gl.invalidate_buffers();
+
+				gl.bind_vertex_array(Light_VAO);
+				gl.bind_buffer(GL_ARRAY_BUFFER, LightPosition_Stream.get_buffer());
+				glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (GLvoid*) LightPosition_Stream.offset());
+
+				if (light_colors_dirty) {
+					gl.bind_buffer(GL_ARRAY_BUFFER, LightColor_VBO);
+					glBufferData(GL_ARRAY_BUFFER, lights.count() * sizeof(glm::vec3), NULL, GL_STATIC_DRAW);
+					// Colors are stored per channel, so they're interleaved straight into the buffer
+					if (lights.count()) {
+						lights.write_colors(static_cast<glm::vec3*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, lights.count() * sizeof(glm::vec3),
+						                                                             GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT)));
+						glUnmapBuffer(GL_ARRAY_BUFFER);
+					}
+					light_colors_dirty = false;
+				}
+			});
 
-			// Update matrix uniforms
-			glUniformMatrix4fv(uGeoWorld, 1, GL_FALSE, glm::value_ptr(monkey_world));
-			glUniformMatrix4fv(uGeoView, 1, GL_FALSE, glm::value_ptr(cam.get_matrix()));
-			glUniformMatrix4fv(uGeoProjection, 1, GL_FALSE, glm::value_ptr(projection));
+			if (mode == Render_Mode::deferred || mode == Render_Mode::tiled) {
+				///////////////////
+				// Geometry Pass //
+				///////////////////
 
-			// Bind gBuffer in order to write to it
-			glBindFramebuffer(GL_FRAMEBUFFER, reninfo.gBuffer);
+				renderer.add_pass("geometry", reninfo.gBuffer, {}, {r_gbuffer}, [&] {
+					// Use geometry pass shaders
+					geometrypass.use(gl);
 
-			// Clear the gBuffer
-			glClearColor(0, 0, 0, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+					// Update matrix uniforms
+					glUniformMatrix4fv(uGeoWorld, 1, GL_FALSE, glm::value_ptr(monkey_world));
 
-			// Use normal depth function
-			glDepthFunc(GL_LESS);
+					// Clear the gBuffer
+					gl.clear_color(0, 0, 0, 1.0f);
+					glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-			// Bind monkey vertex data
-			glBindVertexArray(Monkey_VAO);
-			glBindBuffer(GL_ARRAY_BUFFER, Monkey_VBO);
+					// Use normal depth function
+					gl.depth_func(GL_LESS);
 
-			// Draw elements on the gBuffer
-			glDrawArrays(GL_TRIANGLES, 0, file.objects[0].vertices.size());
+					// Bind monkey vertex data
+					gl.bind_vertex_array(Monkey_VAO);
+					gl.bind_buffer(GL_ARRAY_BUFFER, Monkey_VBO);
 
-			// Bind world vertex data
-			glBindVertexArray(World_VAO);
-			glBindBuffer(GL_ARRAY_BUFFER, World_VBO);
+					glUniform3fv(uGeoPositionScale, 1, glm::value_ptr(monkey_transform.scale));
+					glUniform3fv(uGeoPositionBias, 1, glm::value_ptr(monkey_transform.bias));
 
-			glUniformMatrix4fv(uGeoWorld, 1, GL_FALSE, glm::value_ptr(world_world));
+					// Draw elements on the gBuffer
+					glDrawElements(GL_TRIANGLES, file.objects[0].index_count, IndexType(file.objects[0]), 0);
 
-			glDrawArrays(GL_TRIANGLES, 0, worldfile.objects[0].vertices.size());
-			
-			// Unbind arrays
-			glBindVertexArray(0);
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
+					// Bind world vertex data
+					gl.bind_vertex_array(World_VAO);
+					gl.bind_buffer(GL_ARRAY_BUFFER, World_VBO);
 
-			// Unbind framebuffer
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+					glUniformMatrix4fv(uGeoWorld, 1, GL_FALSE, glm::value_ptr(world_world));
+					glUniform3fv(uGeoPositionScale, 1, glm::value_ptr(world_transform.scale));
+					glUniform3fv(uGeoPositionBias, 1, glm::value_ptr(world_transform.bias));
 
-			////////////////
-			// Depth Blit //
-			////////////////
+					glDrawElements(GL_TRIANGLES, worldfile.objects[0].index_count, IndexType(worldfile.objects[0]), 0);
 			
-			// Blit depth pass to light buffer
-			glBindFramebuffer(GL_READ_FRAMEBUFFER, reninfo.gBuffer);
-			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, reninfo.lBuffer);
 
-			glBlitFramebuffer(0, 0, sdlm.size.width, sdlm.size.height, 0, 0, sdlm.size.width, sdlm.size.height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+					// Unbind arrays
+					gl.bind_vertex_array(0);
+					gl.bind_buffer(GL_ARRAY_BUFFER, 0);
+
+					// Bind the buffers
+					gl.bind_texture(0, GL_TEXTURE_2D, reninfo.gPosition);
+					gl.bind_texture(1, GL_TEXTURE_2D, reninfo.gNormal);
+					gl.bind_texture(2, GL_TEXTURE_2D, reninfo.gAlbedoSpec);
+					gl.bind_texture(3, GL_TEXTURE_2D, reninfo.ssaoNoiseTexture);
+					gl.bind_texture(4, GL_TEXTURE_2D, reninfo.ssaoColor);
+					gl.bind_texture(5, GL_TEXTURE_2D, reninfo.ssaoBlurColor);
+					gl.bind_texture(6, GL_TEXTURE_2D, reninfo.gDepth);
+					if (reninfo.ssaoScale > 1) {
+						gl.bind_texture(11, GL_TEXTURE_2D, reninfo.ssaoLowColor);
+						gl.bind_texture(12, GL_TEXTURE_2D, reninfo.ssaoLowBlurColor[0]);
+						gl.bind_texture(13, GL_TEXTURE_2D, reninfo.ssaoLowBlurColor[1]);
+						gl.bind_texture(14, GL_TEXTURE_2D, reninfo.ssaoLowDepth);
+					}
+				});
 
-			if (SSAO) {
-				// Blit depth pass to ssao buffer
-				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, reninfo.ssaoBuffer);
+				////////////////
+				// Depth Blit //
+				////////////////
 
-				glBlitFramebuffer(0, 0, sdlm.size.width, sdlm.size.height, 0, 0, sdlm.size.width, sdlm.size.height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
-			}
-			glBindFramebuffer(GL_FRAMEBUFFER, reninfo.lBuffer);
-
-			// Bind the buffers
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, reninfo.gPosition);
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, reninfo.gNormal);
-			glActiveTexture(GL_TEXTURE2);
-			glBindTexture(GL_TEXTURE_2D, reninfo.gAlbedoSpec);
-			glActiveTexture(GL_TEXTURE3);
-			glBindTexture(GL_TEXTURE_2D, reninfo.ssaoNoiseTexture);
-			glActiveTexture(GL_TEXTURE4);
-			glBindTexture(GL_TEXTURE_2D, reninfo.ssaoColor);
-			glActiveTexture(GL_TEXTURE5);
-			glBindTexture(GL_TEXTURE_2D, reninfo.ssaoBlurColor);
-			glActiveTexture(GL_TEXTURE6);
-			glBindTexture(GL_TEXTURE_2D, reninfo.gDepth);
-
-			///////////////
-			// SSAO Pass //
-			///////////////
-			
-			if (SSAO) {
-				glBindFramebuffer(GL_FRAMEBUFFER, reninfo.ssaoBuffer);
-			
-				glClearColor(1.0, 1.0, 1.0, 1.0);
-				glClear(GL_COLOR_BUFFER_BIT);
+				// Only with --depth-blits, otherwise lBuffer has gDepth attached and SSAO needs no depth
+				if (!reninfo.sharedDepth) {
+					renderer.add_pass("depth blits", Renderer::no_framebuffer, {r_gbuffer}, {r_depth_copies}, [&] {
+						// Blit depth pass to light buffer
+						glBindFramebuffer(GL_READ_FRAMEBUFFER, reninfo.gBuffer);
+						glBindFramebuffer(GL_DRAW_FRAMEBUFFER, reninfo.lBuffer);
 
-				ssaoPass1.use();
+						glBlitFramebuffer(0, 0, sdlm.size.width, sdlm.size.height, 0, 0, sdlm.size.width, sdlm.size.height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
 
-				glDepthFunc(GL_GREATER);
-				glDepthMask(GL_FALSE);
+						if (SSAO && reninfo.ssaoScale == 1) {
+							// Blit depth pass to ssao buffer
+							glBindFramebuffer(GL_DRAW_FRAMEBUFFER, reninfo.ssaoBuffer);
 
-				glUniformMatrix4fv(uSSAOPass1Projection, 1, GL_FALSE, glm::value_ptr(projection));
+							glBlitFramebuffer(0, 0, sdlm.size.width, sdlm.size.height, 0, 0, sdlm.size.width, sdlm.size.height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+						}
+						gl.invalidate_framebuffer();
+					});
+				}
 
-				RenderFullscreenQuad();
+				///////////////
+				// SSAO Pass //
+				///////////////
 
-				ssaoPass2.use();
+				// Culled when SSAO is off, as the lighting pass stops reading it
+				renderer.add_pass("ssao", Renderer::no_framebuffer, {r_gbuffer, r_depth_copies}, {r_ssao}, [&] {
+					if (reninfo.ssaoScale > 1) {
+						gl.viewport(0, 0, std::max<int>(1, sdlm.size.width / reninfo.ssaoScale), std::max<int>(1, sdlm.size.height / reninfo.ssaoScale));
 
-				glBindFramebuffer(GL_FRAMEBUFFER, reninfo.ssaoBlurBuffer);
-				glClear(GL_COLOR_BUFFER_BIT);
+						// No depth buffer to test against, the shader skips empty pixels itself
+						gl.bind_framebuffer(reninfo.ssaoLowBuffer);
+						gl.depth_mask(GL_FALSE);
 
-				RenderFullscreenQuad();
-			}
-			else {
-				glBindFramebuffer(GL_FRAMEBUFFER, reninfo.ssaoBlurBuffer);
-			
-				glClearColor(1.0, 1.0, 1.0, 1.0);
-				glClear(GL_COLOR_BUFFER_BIT);
-			}
+						ssaoPass1.use(gl);
+						RenderFullscreenQuad(gl);
 
-			glBindFramebuffer(GL_FRAMEBUFFER, reninfo.lBuffer);
+						ssaoBlur.use(gl);
 
-			///////////////////
-			// Lighting Pass //
-			///////////////////
+						gl.bind_framebuffer(reninfo.ssaoLowBlurBuffer[0]);
+						glUniform1i(uSSAOBlurInput, 11);
+						glUniform2i(uSSAOBlurDirection, 1, 0);
+						RenderFullscreenQuad(gl);
 
-			// Clear color
-			glClearColor(0.118, 0.428, 0.860, 1);
-			glClear(GL_COLOR_BUFFER_BIT);
+						gl.bind_framebuffer(reninfo.ssaoLowBlurBuffer[1]);
+						glUniform1i(uSSAOBlurInput, 12);
+						glUniform2i(uSSAOBlurDirection, 0, 1);
+						RenderFullscreenQuad(gl);
 
-			lightingpass.use();
+						gl.viewport(0, 0, sdlm.size.width, sdlm.size.height);
 
-			// Fire the fragment shader if there is an object in front of the square
-			// The square is drawn at the very back
-			glDepthFunc(GL_GREATER);
-			glDepthMask(GL_FALSE);
+						ssaoUpsample.use(gl);
+						gl.bind_framebuffer(reninfo.ssaoBlurBuffer);
+						RenderFullscreenQuad(gl);
+					}
+					else if (reninfo.ssaoTemporal) {
+						gl.bind_framebuffer(reninfo.ssaoBuffer);
 
-			// Upload current view position
-			glUniform3fv(uLightViewPos, 1, glm::value_ptr(cam.get_location()));
+						gl.clear_color(1.0, 1.0, 1.0, 1.0);
+						glClear(GL_COLOR_BUFFER_BIT);
 
-			// Render a quad
-			RenderFullscreenQuad();
+						gl.depth_func(GL_GREATER);
+						gl.depth_mask(GL_FALSE);
 
-			glDepthMask(GL_TRUE);
+						// 4 of the 32 kernel samples, walking the whole kernel every 8 frames
+						ssaoPass1.use(gl);
+						glUniform1i(uSSAOPass1SampleOffset, static_cast<GLint>(fps.get_frame_number() % 8) * 4);
+						glUniform1i(uSSAOPass1SampleCount, 4);
+						glUniform1i(uSSAOPass1RawOcclusion, GL_TRUE);
+						RenderFullscreenQuad(gl);
+						glUniform1i(uSSAOPass1SampleOffset, 0);
+						glUniform1i(uSSAOPass1SampleCount, 32);
+						glUniform1i(uSSAOPass1RawOcclusion, GL_FALSE);
 
-			//////////////////////////////////
-			// Calculate Per Light Lighting //
-			//////////////////////////////////
+						// Blend into the reprojected history. Sky pixels are handled by the shader.
+						size_t previous = reninfo.ssaoHistoryIndex;
+						size_t current = reninfo.ssaoHistoryIndex ^= 1;
 
-			if (dynamic_lighting) {
-				lightbound.use();
+						ssaoTemporal.use(gl);
+						glUniformMatrix4fv(uSSAOTemporalReprojection, 1, GL_FALSE,
+						                   glm::value_ptr(cam.get_previous_view_projection() * glm::inverse(cam.get_matrix())));
 
-				glBindVertexArray(Light_VAO);
+						gl.bind_texture(15, GL_TEXTURE_2D, reninfo.ssaoHistory[previous]);
 
-				glUniformMatrix4fv(uLightBoundPerspective, 1, GL_FALSE, glm::value_ptr(projection));
-				glUniformMatrix4fv(uLightBoundView, 1, GL_FALSE, glm::value_ptr(cam.get_matrix()));
-				glUniform3fv(uLightBoundViewPos, 1, glm::value_ptr(cam.get_location()));
-				glUniform2f(uLightBoundResolution, sdlm.size.width, sdlm.size.height);
+						gl.bind_framebuffer(reninfo.ssaoHistoryBuffer[current]);
+						RenderFullscreenQuad(gl);
 
-				glDepthFunc(GL_LESS);
-				glDepthMask(GL_FALSE);
+						// Blur the accumulated occlusion like the full resolution result
+						gl.bind_texture(4, GL_TEXTURE_2D, reninfo.ssaoHistory[current]);
 
-				glEnable(GL_BLEND);
-				glBlendFunc(GL_ONE, GL_ONE);
-				
-				glEnable(GL_STENCIL_TEST);
-
-				glDisableVertexAttribArray(0);
-				glEnableVertexAttribArray(7);
-
-				for (size_t i = 0; i < lightcount; ++i) {
-					glClear(GL_STENCIL_BUFFER_BIT);
-
-					glUniformMatrix4fv(uLightBoundWorld, 1, GL_FALSE, glm::value_ptr(lighteffectworldmatrix[i]));
-					glUniform3fv(uLightBoundLightColor, 1, glm::value_ptr(lightcolor[i]));
-					glUniform3fv(uLightBoundLightPosition, 1, glm::value_ptr(lightposition[i]));
-					glUniform1f(uLightBoundRadius, lightdata[i].size);
-
-					// Front (near) faces only
-					// Colour write is disabled
-					// Z-write is disabled
-					// Z function is 'Less/Equal'
-					// Z-Fail writes non-zero value to Stencil buffer (for example, 'Increment-Saturate')
-					// Stencil test result does not modify Stencil buffer
-
-					glCullFace(GL_BACK);
-					glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-					glDepthMask(GL_FALSE);
-					glDepthFunc(GL_LEQUAL);
-					glStencilMask(GL_TRUE);
-					glStencilOp(GL_KEEP, GL_INCR, GL_KEEP);
-					glStencilFunc(GL_ALWAYS, 0, 0xFF);
-
-					glDrawArrays(GL_TRIANGLES, 0, circlefile.objects[0].vertices.size());
-
-					// Back (far) faces only
-					// Colour write enabled
-					// Z-write is disabled
-					// Z function is 'Greater/Equal'
-					// Stencil function is 'Equal' (Stencil ref = zero)
-					// Always clears Stencil to zero
-
-					glCullFace(GL_FRONT);
-					glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-					// Z-write already disabled
-					glDepthFunc(GL_GEQUAL);
-					glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
-					glStencilFunc(GL_EQUAL, 0, 0x00);
-
-					glDrawArrays(GL_TRIANGLES, 0, circlefile.objects[0].vertices.size());
+						ssaoPass2.use(gl);
+						gl.bind_framebuffer(reninfo.ssaoBlurBuffer);
+						glClear(GL_COLOR_BUFFER_BIT);
+						RenderFullscreenQuad(gl);
+
+						gl.bind_texture(4, GL_TEXTURE_2D, reninfo.ssaoColor);
+					}
+					else {
+						gl.bind_framebuffer(reninfo.ssaoBuffer);
+			
+						gl.clear_color(1.0, 1.0, 1.0, 1.0);
+						glClear(GL_COLOR_BUFFER_BIT);
+
+						ssaoPass1.use(gl);
+
+						gl.depth_func(GL_GREATER);
+						gl.depth_mask(GL_FALSE);
+
+
+						RenderFullscreenQuad(gl);
+
+						ssaoPass2.use(gl);
+
+						gl.bind_framebuffer(reninfo.ssaoBlurBuffer);
+						glClear(GL_COLOR_BUFFER_BIT);
+
+						RenderFullscreenQuad(gl);
+					}
+				});
+
+				///////////////////
+				// Lighting Pass //
+				///////////////////
+
+				std::vector<Renderer::Resource> lighting_reads = {r_lights, r_gbuffer, r_depth_copies};
+				if (SSAO) {
+					lighting_reads.push_back(r_ssao);
 				}
+				renderer.add_pass("lighting", reninfo.lBuffer, lighting_reads, {r_scene}, [&] {
+					// The sun samples gDepth, so with shared depth it draws without it attached and skips the sky itself
+					if (reninfo.sharedDepth) {
+						gl.bind_framebuffer(reninfo.lColorBuffer);
+					}
 
-				glDisableVertexAttribArray(7);
-				glEnableVertexAttribArray(0);
+					// Clear color
+					gl.clear_color(0.118, 0.428, 0.860, 1);
+					glClear(GL_COLOR_BUFFER_BIT);
 
-				glCullFace(GL_BACK);
-				glDepthMask(GL_TRUE);
-				glDepthFunc(GL_LEQUAL);
-				glStencilFunc(GL_ALWAYS, 0, 0xFF);
-				glDisable(GL_STENCIL_TEST);
-				glDisable(GL_BLEND);
-			}
+					lightingpass.use(gl);
 
-			// Blit depth pass to current depth
-			glBindFramebuffer(GL_READ_FRAMEBUFFER, reninfo.gBuffer);
-			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, reninfo.lBuffer);
+					// Fire the fragment shader if there is an object in front of the square
+					// The square is drawn at the very back
+					gl.depth_func(GL_GREATER);
+					gl.depth_mask(GL_FALSE);
 
-			glBlitFramebuffer(0, 0, sdlm.size.width, sdlm.size.height, 0, 0, sdlm.size.width, sdlm.size.height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
-			glBindFramebuffer(GL_FRAMEBUFFER, reninfo.lBuffer);
+					// Upload current view position
+					glUniform1i(uLightSSAOEnabled, SSAO);
 
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		}
-		else {
-			glBindFramebuffer(GL_FRAMEBUFFER, reninfo.lBuffer);
+					// Render a quad
+					RenderFullscreenQuad(gl);
 
-			glClearColor(0.118, 0.428, 0.860, 1);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			forward_sun.use();
-			
-			auto render_scene = [&](GLuint world, GLuint view, GLuint proj) {
-				glUniformMatrix4fv(world, 1, GL_FALSE, glm::value_ptr(monkey_world));
-				glUniformMatrix4fv(view, 1, GL_FALSE, glm::value_ptr(cam.get_matrix()));
-				glUniformMatrix4fv(proj, 1, GL_FALSE, glm::value_ptr(projection));
+					gl.depth_mask(GL_TRUE);
+
+					if (reninfo.sharedDepth) {
+						gl.bind_framebuffer(reninfo.lBuffer);
+						// The volumes sample gDepth while depth testing against it. Nothing writes it
+						// while it's attached here, so one barrier after the geometry pass makes that defined.
+						if (mode == Render_Mode::deferred && dynamic_lighting) {
+							glTextureBarrier();
+						}
+					}
+
+					//////////////////////////////////
+					// Calculate Per Light Lighting //
+					//////////////////////////////////
+
+					if (mode == Render_Mode::tiled) {
+						// Shades over the sun pass already in lColor, so only touches each pixel once
+						lighttiled.use(gl);
+
+						glUniform1ui(uLightTiledLightCount, dynamic_lighting ? lights.count() : 0);
+						glUniform1i(uLightTiledHeatmap, tile_heatmap);
+
+						glBindImageTexture(0, reninfo.lColor, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
+						if (lights.count()) {
+							glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, LightPosition_Stream.get_buffer(), LightPosition_Stream.offset(),
+							                  lights.count() * sizeof(glm::vec4));
+							glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 1, LightColor_VBO, 0, lights.count() * sizeof(glm::vec3));
+						}
+
+						glDispatchCompute((sdlm.size.width + 15) / 16, (sdlm.size.height + 15) / 16, 1);
+
+						// The sprites, mipmap generation and the HDR pass all read or write lColor next
+						glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+					}
+					else if (draw_volumes_instanced) {
+						// Every light's volume in one draw. Back faces only, so the camera
+						// can be inside a volume; the shader rejects what's outside the radius.
+						lightinstanced.use(gl);
+
+						gl.bind_vertex_array(Light_VAO);
+						BindInstanceMatrix(gl, 2, LightVolume_Stream);
 
-				glBindVertexArray(Monkey_VAO);
+						gl.depth_mask(GL_FALSE);
+						gl.depth_func(GL_GEQUAL);
+						gl.cull_face(GL_FRONT);
 
-				glDrawArrays(GL_TRIANGLES, 0, file.objects[0].vertices.size());
+						gl.enable(GL_BLEND);
+						gl.blend_func(GL_ONE, GL_ONE);
 
-				glUniformMatrix4fv(world, 1, GL_FALSE, glm::value_ptr(world_world));
+						glDisableVertexAttribArray(0);
+						glEnableVertexAttribArray(7);
+						gl.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, LightCircle_EBO);
 
-				glBindVertexArray(World_VAO);
+						glDrawElementsInstanced(GL_TRIANGLES, circlefile.objects[0].index_count, IndexType(circlefile.objects[0]), 0, lights.count());
 
-				glDrawArrays(GL_TRIANGLES, 0, worldfile.objects[0].vertices.size());
+						glDisableVertexAttribArray(7);
+						glEnableVertexAttribArray(0);
 
-				glBindVertexArray(0);
-			};
+						gl.cull_face(GL_BACK);
+						gl.depth_mask(GL_TRUE);
+						gl.depth_func(GL_LEQUAL);
+						gl.disable(GL_BLEND);
+					}
+					else if (dynamic_lighting) {
+						lightbound.use(gl);
+
+						gl.bind_vertex_array(Light_VAO);
+
+						gl.depth_func(GL_LESS);
+						gl.depth_mask(GL_FALSE);
 
-			////////////////////
-			// Depth Pre-Pass //
-			////////////////////
+						gl.enable(GL_BLEND);
+						gl.blend_func(GL_ONE, GL_ONE);
+				
+						gl.enable(GL_STENCIL_TEST);
+
+						glDisableVertexAttribArray(0);
+						glEnableVertexAttribArray(7);
+						gl.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, LightCircle_EBO);
+
+						for (size_t i = 0; i < lights.count(); ++i) {
+							glClear(GL_STENCIL_BUFFER_BIT);
+
+							auto transform = lights.transform(i);
+							glUniformMatrix4fv(uLightBoundWorld, 1, GL_FALSE, glm::value_ptr(transform.volume_matrix));
+							glUniform3fv(uLightBoundLightColor, 1, glm::value_ptr(lights.get_color(i)));
+							glUniform3fv(uLightBoundLightPosition, 1, glm::value_ptr(transform.view_position));
+							glUniform1f(uLightBoundRadius, lights.get_radius(i));
+
+							// Front (near) faces only
+							// Colour write is disabled
+							// Z-write is disabled
+							// Z function is 'Less/Equal'
+							// Z-Fail writes non-zero value to Stencil buffer (for example, 'Increment-Saturate')
+							// Stencil test result does not modify Stencil buffer
+
+							gl.cull_face(GL_BACK);
+							gl.color_mask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+							gl.depth_mask(GL_FALSE);
+							gl.depth_func(GL_LEQUAL);
+							gl.stencil_mask(GL_TRUE);
+							gl.stencil_op(GL_KEEP, GL_INCR, GL_KEEP);
+							gl.stencil_func(GL_ALWAYS, 0, 0xFF);
+
+							glDrawElements(GL_TRIANGLES, circlefile.objects[0].index_count, IndexType(circlefile.objects[0]), 0);
+
+							// Back (far) faces only
+							// Colour write enabled
+							// Z-write is disabled
+							// Z function is 'Greater/Equal'
+							// Stencil function is 'Equal' (Stencil ref = zero)
+							// Always clears Stencil to zero
+
+							gl.cull_face(GL_FRONT);
+							gl.color_mask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+							// Z-write already disabled
+							gl.depth_func(GL_GEQUAL);
+							gl.stencil_op(GL_KEEP, GL_KEEP, GL_KEEP);
+							gl.stencil_func(GL_EQUAL, 0, 0x00);
+
+							glDrawElements(GL_TRIANGLES, circlefile.objects[0].index_count, IndexType(circlefile.objects[0]), 0);
+						}
+
+						glDisableVertexAttribArray(7);
+						glEnableVertexAttribArray(0);
+
+						gl.cull_face(GL_BACK);
+						gl.depth_mask(GL_TRUE);
+						gl.depth_func(GL_LEQUAL);
+						gl.stencil_func(GL_ALWAYS, 0, 0xFF);
+						gl.disable(GL_STENCIL_TEST);
+						gl.disable(GL_BLEND);
+					}
 
-			glDepthFunc(GL_LESS);
-			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+					if (!reninfo.sharedDepth) {
+						// Blit depth pass to current depth
+						glBindFramebuffer(GL_READ_FRAMEBUFFER, reninfo.gBuffer);
+						glBindFramebuffer(GL_DRAW_FRAMEBUFFER, reninfo.lBuffer);
+
+						glBlitFramebuffer(0, 0, sdlm.size.width, sdlm.size.height, 0, 0, sdlm.size.width, sdlm.size.height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+						gl.invalidate_framebuffer();
+					}
+				});
+			}
+			else {
+				renderer.add_pass("forward", reninfo.lBuffer, {r_lights}, {r_scene}, [&] {
+					gl.clear_color(0.118, 0.428, 0.860, 1);
+					glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+					forward_sun.use(gl);
 			
-			render_scene(uForwardSunWorld, uForwardSunView, uForwardSunProjection);
+					auto render_scene = [&](GLuint world, GLuint scale, GLuint bias) {
+						glUniformMatrix4fv(world, 1, GL_FALSE, glm::value_ptr(monkey_world));
+						glUniform3fv(scale, 1, glm::value_ptr(monkey_transform.scale));
+						glUniform3fv(bias, 1, glm::value_ptr(monkey_transform.bias));
 
-			glDepthFunc(GL_LEQUAL);
-			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+						gl.bind_vertex_array(Monkey_VAO);
 
-			render_scene(uForwardSunWorld, uForwardSunView, uForwardSunProjection);
+						glDrawElements(GL_TRIANGLES, file.objects[0].index_count, IndexType(file.objects[0]), 0);
 
-			if (dynamic_lighting) {
-				forward_lights.use();
-				glDepthMask(GL_FALSE);
-				glEnable(GL_BLEND);
-				glBlendFunc(GL_ONE, GL_ONE);
+						glUniformMatrix4fv(world, 1, GL_FALSE, glm::value_ptr(world_world));
+						glUniform3fv(scale, 1, glm::value_ptr(world_transform.scale));
+						glUniform3fv(bias, 1, glm::value_ptr(world_transform.bias));
 
-				for (size_t i = 0; i < lightcount; ++i) {
-					glUniform3fv(uForwardLightsLightPosition, 1, glm::value_ptr(lightposition[i]));
-					glUniform3fv(uForwardLightsLightColor, 1, glm::value_ptr(lightcolor[i]));
-					glUniform1f(uForwardLightsRadius, lightdata[i].size);
+						gl.bind_vertex_array(World_VAO);
 
-					render_scene(uForwardLightsWorld, uForwardLightsView, uForwardLightsProjection);
-				}
+						glDrawElements(GL_TRIANGLES, worldfile.objects[0].index_count, IndexType(worldfile.objects[0]), 0);
+
+						gl.bind_vertex_array(0);
+					};
+
+					////////////////////
+					// Depth Pre-Pass //
+					////////////////////
 
-				glDisable(GL_BLEND);
-				glBlendFunc(GL_ONE, GL_ZERO);
-				glDepthMask(GL_TRUE);
+					gl.depth_func(GL_LESS);
+					gl.color_mask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			
+					render_scene(uForwardSunWorld, uForwardSunPositionScale, uForwardSunPositionBias);
+
+					gl.depth_func(GL_LEQUAL);
+					gl.color_mask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+					render_scene(uForwardSunWorld, uForwardSunPositionScale, uForwardSunPositionBias);
+
+					if (clustered) {
+						// One pass, each fragment only walks the lights binned into its cluster
+						forward_clustered.use(gl);
+						gl.depth_mask(GL_FALSE);
+						gl.enable(GL_BLEND);
+						gl.blend_func(GL_ONE, GL_ONE);
+
+						glUniform2i(uForwardClusteredGridSize, clusters.grid_width(), clusters.grid_height());
+						glUniform1f(uForwardClusteredSliceScale, clusters.get_slice_scale());
+						glUniform1f(uForwardClusteredSliceBias, clusters.get_slice_bias());
+
+						gl.bind_texture(7, GL_TEXTURE_BUFFER, ClusterGrid_TBO);
+						glTexBufferRange(GL_TEXTURE_BUFFER, GL_RG32UI, ClusterGrid_Stream.get_buffer(), ClusterGrid_Stream.offset(), clusters.cluster_count() * sizeof(glm::uvec2));
+						// Empty lists are never read, as every cluster's count is 0
+						if (!clusters.get_indices().empty()) {
+							gl.bind_texture(8, GL_TEXTURE_BUFFER, ClusterIndex_TBO);
+							glTexBufferRange(GL_TEXTURE_BUFFER, GL_R32UI, ClusterIndex_Stream.get_buffer(), ClusterIndex_Stream.offset(), clusters.get_indices().size() * sizeof(std::uint32_t));
+							gl.bind_texture(9, GL_TEXTURE_BUFFER, LightPosition_TBO);
+							glTexBufferRange(GL_TEXTURE_BUFFER, GL_RGBA32F, LightPosition_Stream.get_buffer(), LightPosition_Stream.offset(), lights.count() * sizeof(glm::vec4));
+							gl.bind_texture(10, GL_TEXTURE_BUFFER, LightColor_TBO);
+							glTexBuffer(GL_TEXTURE_BUFFER, GL_RGB32F, LightColor_VBO);
+						}
+
+						render_scene(uForwardClusteredWorld, uForwardClusteredPositionScale, uForwardClusteredPositionBias);
+
+						gl.disable(GL_BLEND);
+						gl.blend_func(GL_ONE, GL_ZERO);
+						gl.depth_mask(GL_TRUE);
+					}
+					else if (dynamic_lighting) {
+						forward_lights.use(gl);
+						gl.depth_mask(GL_FALSE);
+						gl.enable(GL_BLEND);
+						gl.blend_func(GL_ONE, GL_ONE);
+
+						for (size_t i = 0; i < lights.count(); ++i) {
+							glUniform3fv(uForwardLightsLightPosition, 1, glm::value_ptr(lights.transform(i).view_position));
+							glUniform3fv(uForwardLightsLightColor, 1, glm::value_ptr(lights.get_color(i)));
+							glUniform1f(uForwardLightsRadius, lights.get_radius(i));
+
+							render_scene(uForwardLightsWorld, uForwardLightsPositionScale, uForwardLightsPositionBias);
+						}
+
+						gl.disable(GL_BLEND);
+						gl.blend_func(GL_ONE, GL_ZERO);
+						gl.depth_mask(GL_TRUE);
+					}
+				});
 			}
-		}
 
-		////////////////
-		// Light Pass //
-		////////////////
+			////////////////
+			// Light Pass //
+			////////////////
 
-		glBindFramebuffer(GL_FRAMEBUFFER, reninfo.lBuffer);
+			renderer.add_pass("sprites", reninfo.lBuffer, {r_lights, r_scene}, {r_scene}, [&] {
+				drawlights.use(gl);
 
-		drawlights.use();
+				gl.depth_func(GL_LESS);
 
-		glDepthFunc(GL_LESS);
+				gl.bind_vertex_array(Light_VAO);
+				gl.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, Light_EBO);
+				BindInstanceMatrix(gl, 2, LightSprite_Stream);
 
-		glBindVertexArray(Light_VAO);
-		glBindBuffer(GL_ARRAY_BUFFER, LightTransform_VBO);
-		glBufferData(GL_ARRAY_BUFFER, lightcount * sizeof(glm::mat4), lightworldmatrix.data(), GL_STREAM_DRAW);
+				glDrawElementsInstanced(GL_TRIANGLES, squarefile.objects[0].index_count, IndexType(squarefile.objects[0]), 0, lights.count());
 
-		glUniformMatrix4fv(uDrawLightsView, 1, GL_FALSE, glm::value_ptr(cam.get_matrix()));
-		glUniformMatrix4fv(uDrawLightsPerspective, 1, GL_FALSE, glm::value_ptr(projection));
+				gl.bind_vertex_array(0);
+			});
 
-		glDrawArraysInstanced(GL_TRIANGLES, 0, squarefile.objects[0].vertices.size(), lightcount);
+			////////////////////////////
+			// HDR/Gamma Post Process //
+			////////////////////////////
 
-		glBindVertexArray(0);
+			renderer.add_pass("hdr", sdlm.output_framebuffer(), {r_scene}, {r_backbuffer}, [&] {
+				gl.bind_texture(0, GL_TEXTURE_2D, reninfo.lColor);
 
-		////////////////////////////
-		// HDR/Gamma Post Process //
-		////////////////////////////
+				// Stays on the GPU's value until the manual one has been seeded from it
+				bool gpu_exposure = gpu_exposure_supported && (!manual_exposure || exposure_seed_pending);
+				if (gpu_exposure) {
+					luminance_histogram.use(gl);
+					glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, Luminance_Histogram_SSBO);
+					glDispatchCompute((sdlm.size.width + 15) / 16, (sdlm.size.height + 15) / 16, 1);
+					glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
-		// Average color
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, reninfo.lColor);
-		glGenerateMipmap(GL_TEXTURE_2D);
+					exposure_adapt.use(gl);
+					glUniform1f(uExposureAdaptDeltaTime, delta_time);
+					glBindImageTexture(1, Exposure_Texture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+					glDispatchCompute(1, 1, 1);
+					// The adapt pass zeroed the histogram, which next frame's histogram pass adds into
+					glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT |
+					                GL_SHADER_STORAGE_BARRIER_BIT);
 
-		size_t mipmap_levels = 1 + std::floor(std::log2(std::max(sdlm.size.width, sdlm.size.height)));
-		glm::vec3 avg;
-		glGetTexImage(GL_TEXTURE_2D, mipmap_levels - 1, GL_RGB, GL_FLOAT, glm::value_ptr(avg));
+					gl.bind_texture(1, GL_TEXTURE_2D, Exposure_Texture);
+				}
+				else if (!gpu_exposure_supported && !manual_exposure) {
+					// Average color
+					glGenerateMipmap(GL_TEXTURE_2D);
 
-		// Change exposure
-		float luminosity = 0.21 * avg.r + 0.71 * avg.g + 0.07 * avg.b;
-		float newexposure = 1.0 / (luminosity + (1.0 - 0.4));
-		float diff = newexposure - exposure;
-		if (diff < 0) {
-			exposure += (diff * fps.get_delta_time()) / 0.5;
-		}
-		else {
-			exposure += std::min<float>(diff, 0.2 * fps.get_delta_time());
-		}
+					size_t mipmap_levels = 1 + std::floor(std::log2(std::max(sdlm.size.width, sdlm.size.height)));
+					Exposure_Readback.get_tex_image(GL_TEXTURE_2D, mipmap_levels - 1, GL_RGB, GL_FLOAT);
 
-		#ifdef DLDEBUG
-		// std::cerr << luminosity << " - " << (1.0 / exposure) - (1.0 - 0.3) << '\n';
-		#endif
+					// Change exposure, towards the newest average the GPU has finished
+					glm::vec3 avg;
+					if (Exposure_Readback.latest(glm::value_ptr(avg))) {
+						luminosity = 0.21 * avg.r + 0.71 * avg.g + 0.07 * avg.b;
+					}
+					float newexposure = 1.0 / (luminosity + (1.0 - 0.4));
+					float diff = newexposure - exposure;
+					if (diff < 0) {
+						exposure += (diff * delta_time) / 0.5;
+					}
+					else {
+						exposure += std::min<float>(diff, 0.2 * delta_time);
+					}
+				}
 
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+				#ifdef DLDEBUG
+				// std::cerr << luminosity << " - " << (1.0 / exposure) - (1.0 - 0.3) << '\n';
+				#endif
 
-		hdr_pass.use();
+				hdr_pass.use(gl);
 
-		glUniform1f(uHDRExposure, exposure);
+				glUniform1f(uHDRExposure, exposure);
+				glUniform1i(uHDRGpuExposure, gpu_exposure);
 
-		glClearColor(0, 0, 0, 1);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				gl.clear_color(0, 0, 0, 1);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		glDisable(GL_DEPTH_TEST);
+				gl.disable(GL_DEPTH_TEST);
 
-		RenderFullscreenQuad();
+				RenderFullscreenQuad(gl);
 
-		glEnable(GL_DEPTH_TEST);
+				gl.enable(GL_DEPTH_TEST);
+			});
+		}
+
+		renderer.execute(profiler);
+
+		LightPosition_Stream.end_frame();
+		LightSprite_Stream.end_frame();
+		LightVolume_Stream.end_frame();
+		ClusterGrid_Stream.end_frame();
+		ClusterIndex_Stream.end_frame();
+		Frame_Stream.end_frame();
 
 		// Swap buffers
-		SDL_GL_SwapWindow(sdlm.mainWindow);
+		cam.end_frame(projection);
+
+		sdlm.swap();
+
+		// The benchmark waits for every frame's GPU times so each CSV row is complete
+		profiler.end_frame(headless);
+		reninfo.targets.end_frame();
+		gl.end_frame();
+		if (fps.printed()) {
+			profiler.print(std::cout);
+			reninfo.targets.print(std::cout);
+			gl.print(std::cout);
+		}
+
+		if (headless) {
+			double frame_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count();
+
+			auto& passes = profiler.get_passes();
+			if (bench_frame == 0) {
+				bench_out << "frame,lights,mode,frame_ms,gl_calls,gl_calls_elided";
+				for (auto& pass : passes) {
+					bench_out << ',' << pass.name << "_cpu_ms," << pass.name << "_gpu_ms";
+				}
+				bench_out << '\n';
+			}
+			static const char* mode_names[] = {"deferred", "tiled", "clustered", "forward"};
+			bench_out << bench_frame << ',' << lights.count() << ',' << mode_names[static_cast<int>(mode)] << ',' << frame_ms << ','
+			          << gl.get_counters().issued << ',' << gl.get_counters().elided;
+			for (auto& pass : passes) {
+				bench_out << ',' << pass.cpu_ms << ',' << pass.gpu_ms;
+			}
+			bench_out << '\n';
+
+			++bench_frame;
+		}
+	}
+
+	if (headless && !dump_frame.empty()) {
+		DumpFrame(dump_frame, sdlm);
+	}
+	if (headless) {
+		profiler.write_trace(trace_file);
 	}
 
 	return 0;
@@ -1084,7 +1885,7 @@ void APIENTRY openglCallbackFunction(GLenum source,
 // and post-processing effects.
 GLuint quadVAO = 0;
 GLuint quadVBO;
-void RenderFullscreenQuad()
+void RenderFullscreenQuad(GL_State& gl)
 {
 	if (quadVAO == 0)
 	{
@@ -1098,17 +1899,47 @@ void RenderFullscreenQuad()
 		// Setup plane VAO
 		glGenVertexArrays(1, &quadVAO);
 		glGenBuffers(1, &quadVBO);
-		glBindVertexArray(quadVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+		gl.bind_vertex_array(quadVAO);
+		gl.bind_buffer(GL_ARRAY_BUFFER, quadVBO);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
 		glEnableVertexAttribArray(0);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (GLvoid*)0);
 		glEnableVertexAttribArray(1);
 		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
 	}
-	glBindVertexArray(quadVAO);
+	gl.bind_vertex_array(quadVAO);
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	glBindVertexArray(0);
+}
+
+GLenum IndexType(const Mesh_Object& obj) {
+	return obj.index_size == sizeof(GLushort) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+void BindInstanceMatrix(GL_State& gl, GLuint location, const Stream_Buffer& stream) {
+	gl.bind_buffer(GL_ARRAY_BUFFER, stream.get_buffer());
+	for (GLuint col = 0; col < 4; ++col) {
+		glVertexAttribPointer(location + col, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (GLvoid*) (stream.offset() + col * sizeof(glm::vec4)));
+	}
+}
+
+Vertex_Transform UploadVertices(const Mesh_Object& obj, bool packed) {
+	if (!packed) {
+		glBufferData(GL_ARRAY_BUFFER, obj.vertex_count * sizeof(Vertex), obj.vertices, GL_STATIC_DRAW);
+		apply_vertex_layout(float_vertex_layout);
+		return Vertex_Transform{glm::vec3(1.0f), glm::vec3(0.0f)};
+	}
+
+	auto p = pack_object(obj);
+	glBufferData(GL_ARRAY_BUFFER, p.vertices.size() * sizeof(Packed_Vertex), p.vertices.data(), GL_STATIC_DRAW);
+	apply_vertex_layout(packed_vertex_layout);
+
+	#ifdef DLDEBUG
+	std::cerr << obj.name << ": packed " << obj.vertex_count * sizeof(Vertex) / 1024 << "KB -> "
+	          << p.vertices.size() * sizeof(Packed_Vertex) / 1024 << "KB, max position error " << p.max_position_error
+	          << ", max normal error " << p.max_normal_error << " degrees\n";
+	#endif
+
+	return Vertex_Transform{glm::make_vec3(p.scale), glm::make_vec3(p.bias)};
 }
 
 void Check_RenderBuffer() {
@@ -1137,49 +1968,34 @@ void PrepareBuffers(size_t x, size_t y, RenderInfo& data) {
 	glGenFramebuffers(1, &data.gBuffer);
 	glBindFramebuffer(GL_FRAMEBUFFER, data.gBuffer);
 
+	// Attachments are packed, the compact layout has no position target
+	GLenum attachments[3];
+	GLsizei attachment_count = 0;
+
 	// - Position color buffer
-	glGenTextures(1, &data.gPosition);
-	glBindTexture(GL_TEXTURE_2D, data.gPosition);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, x, y, 0, GL_RGB, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); 
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, data.gPosition, 0);
+	data.gPosition = 0;
+	if (!data.compactGBuffer) {
+		data.gPosition = data.targets.acquire(GL_RGBA32F, x, y);
+		attachments[attachment_count] = GL_COLOR_ATTACHMENT0 + attachment_count;
+		glFramebufferTexture2D(GL_FRAMEBUFFER, attachments[attachment_count++], GL_TEXTURE_2D, data.gPosition, 0);
+	}
 	  
-	// - Normal color buffer
-	glGenTextures(1, &data.gNormal);
-	glBindTexture(GL_TEXTURE_2D, data.gNormal);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, x, y, 0, GL_RGB, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); 
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, data.gNormal, 0);
+	// - Normal color buffer, octahedral in the compact layout
+	data.gNormal = data.targets.acquire(data.compactGBuffer ? GL_RG16 : GL_RGB16F, x, y);
+	attachments[attachment_count] = GL_COLOR_ATTACHMENT0 + attachment_count;
+	glFramebufferTexture2D(GL_FRAMEBUFFER, attachments[attachment_count++], GL_TEXTURE_2D, data.gNormal, 0);
 	  
 	// - Color + Specular color buffer
-	glGenTextures(1, &data.gAlbedoSpec);
-	glBindTexture(GL_TEXTURE_2D, data.gAlbedoSpec);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, x, y, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); 
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, data.gAlbedoSpec, 0);
+	data.gAlbedoSpec = data.targets.acquire(GL_RGBA8, x, y);
+	attachments[attachment_count] = GL_COLOR_ATTACHMENT0 + attachment_count;
+	glFramebufferTexture2D(GL_FRAMEBUFFER, attachments[attachment_count++], GL_TEXTURE_2D, data.gAlbedoSpec, 0);
 
 	// - Depth buffer
-	glGenTextures(1, &data.gDepth);
-	glBindTexture(GL_TEXTURE_2D, data.gDepth);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH32F_STENCIL8, x, y, 0, GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); 
+	data.gDepth = data.targets.acquire(GL_DEPTH32F_STENCIL8, x, y);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, data.gDepth, 0);
 	  
 	// - Tell OpenGL which color attachments we'll use (of this framebuffer) for rendering 
-	constexpr GLuint attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
-	glDrawBuffers(3, attachments);
+	glDrawBuffers(attachment_count, attachments);
 
 	Check_RenderBuffer();
 
@@ -1191,24 +2007,20 @@ void PrepareBuffers(size_t x, size_t y, RenderInfo& data) {
 	glBindFramebuffer(GL_FRAMEBUFFER, data.lBuffer);
 
 	// Light buffer
-	glGenTextures(1, &data.lColor);
-	glBindTexture(GL_TEXTURE_2D, data.lColor);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, x, y, 0, GL_RGB, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); 
+	data.lColor = data.targets.acquire(GL_RGBA16F, x, y);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, data.lColor, 0);
 
-	// Depth Buffer
-	glGenTextures(1, &data.lDepth);
-	glBindTexture(GL_TEXTURE_2D, data.lDepth);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH32F_STENCIL8, x, y, 0, GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); 
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, data.lDepth, 0);
+	// Depth Buffer. Shared, the forward modes clear and write it and the sprites
+	// write it, but nothing reads gDepth after them until the next geometry pass.
+	data.lDepth = data.sharedDepth ? 0 : data.targets.acquire(GL_DEPTH32F_STENCIL8, x, y);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, data.sharedDepth ? data.gDepth : data.lDepth, 0);
+
+	Check_RenderBuffer();
+
+	// Light color only
+	glGenFramebuffers(1, &data.lColorBuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, data.lColorBuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, data.lColor, 0);
 
 	Check_RenderBuffer();
 
@@ -1220,23 +2032,15 @@ void PrepareBuffers(size_t x, size_t y, RenderInfo& data) {
 	glGenFramebuffers(1, &data.ssaoBuffer);
 	glBindFramebuffer(GL_FRAMEBUFFER, data.ssaoBuffer);
 
-	glGenTextures(1, &data.ssaoColor);
-	glBindTexture(GL_TEXTURE_2D, data.ssaoColor);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, x, y, 0, GL_RGB, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); 
+	data.ssaoColor = data.targets.acquire(GL_R16F, x, y);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, data.ssaoColor, 0);
 
-	glGenTextures(1, &data.ssaoDepth);
-	glBindTexture(GL_TEXTURE_2D, data.ssaoDepth);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F , x, y, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); 
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, data.ssaoDepth, 0);
+	// Shared, there's no depth at all, as the first pass samples gDepth and skips the sky itself
+	data.ssaoDepth = 0;
+	if (!data.sharedDepth) {
+		data.ssaoDepth = data.targets.acquire(GL_DEPTH_COMPONENT32F, x, y);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, data.ssaoDepth, 0);
+	}
 
 
 	Check_RenderBuffer();
@@ -1245,38 +2049,118 @@ void PrepareBuffers(size_t x, size_t y, RenderInfo& data) {
 	glGenFramebuffers(1, &data.ssaoBlurBuffer);
 	glBindFramebuffer(GL_FRAMEBUFFER, data.ssaoBlurBuffer);
 
-	glGenTextures(1, &data.ssaoBlurColor);
-	glBindTexture(GL_TEXTURE_2D, data.ssaoBlurColor);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, x, y, 0, GL_RGB, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); 
+	data.ssaoBlurColor = data.targets.acquire(GL_R16F, x, y);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, data.ssaoBlurColor, 0);
 
 	Check_RenderBuffer();
 
+	// Reduced resolution passes, upsampled into ssaoBlurColor
+	if (data.ssaoScale > 1) {
+		size_t low_x = std::max<size_t>(1, x / data.ssaoScale);
+		size_t low_y = std::max<size_t>(1, y / data.ssaoScale);
+
+		// Occlusion and linear depth, written together by the first pass
+		glGenFramebuffers(1, &data.ssaoLowBuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, data.ssaoLowBuffer);
+
+		data.ssaoLowColor = data.targets.acquire(GL_R8, low_x, low_y);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, data.ssaoLowColor, 0);
+		data.ssaoLowDepth = data.targets.acquire(GL_R16F, low_x, low_y);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, data.ssaoLowDepth, 0);
+
+		constexpr GLuint low_attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers(2, low_attachments);
+
+		Check_RenderBuffer();
+
+		// Horizontal then vertical blur
+		for (size_t i = 0; i < 2; ++i) {
+			glGenFramebuffers(1, &data.ssaoLowBlurBuffer[i]);
+			glBindFramebuffer(GL_FRAMEBUFFER, data.ssaoLowBlurBuffer[i]);
+
+			data.ssaoLowBlurColor[i] = data.targets.acquire(GL_R8, low_x, low_y);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, data.ssaoLowBlurColor[i], 0);
+
+			Check_RenderBuffer();
+		}
+	}
+
+	if (data.ssaoTemporal) {
+		for (size_t i = 0; i < 2; ++i) {
+			glGenFramebuffers(1, &data.ssaoHistoryBuffer[i]);
+			glBindFramebuffer(GL_FRAMEBUFFER, data.ssaoHistoryBuffer[i]);
+
+			data.ssaoHistory[i] = data.targets.acquire(GL_RGBA16F, x, y);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, data.ssaoHistory[i], 0);
+
+			Check_RenderBuffer();
+
+			// Zero depth never matches, so the first frame starts without history
+			glClearColor(0, 0, 0, 0);
+			glClear(GL_COLOR_BUFFER_BIT);
+		}
+	}
+
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
+size_t GBufferBytesPerPixel(bool compact) {
+	// Three component targets are padded to four, the depth-stencil is 32F + 8 padded to 64 bits
+	size_t color = compact ? 4 + 4 : 16 + 8 + 4;
+	return color + 8;
+}
+
 void DeleteBuffers(RenderInfo & data) {
-	glDeleteTextures(1, &data.gPosition);
-	glDeleteTextures(1, &data.gNormal);
-	glDeleteTextures(1, &data.gAlbedoSpec);
-	glDeleteTextures(1, &data.gDepth);
-	glDeleteTextures(1, &data.lColor);
-	glDeleteTextures(1, &data.lDepth);
-	glDeleteTextures(1, &data.ssaoColor);
-	glDeleteTextures(1, &data.ssaoBlurColor);
+	// Textures go back to the pool for a settings change to reuse, Resize frees the ones it leaves behind
+	for (GLuint texture : {data.gPosition, data.gNormal, data.gAlbedoSpec, data.gDepth, data.lColor, data.lDepth,
+	                       data.ssaoColor, data.ssaoDepth, data.ssaoBlurColor}) {
+		data.targets.release(texture);
+	}
 	glDeleteFramebuffers(1, &data.gBuffer);
 	glDeleteFramebuffers(1, &data.lBuffer);
+	glDeleteFramebuffers(1, &data.lColorBuffer);
 	glDeleteFramebuffers(1, &data.ssaoBuffer);
 	glDeleteFramebuffers(1, &data.ssaoBlurBuffer);
+	if (data.ssaoScale > 1) {
+		data.targets.release(data.ssaoLowColor);
+		data.targets.release(data.ssaoLowDepth);
+		data.targets.release(data.ssaoLowBlurColor[0]);
+		data.targets.release(data.ssaoLowBlurColor[1]);
+		glDeleteFramebuffers(1, &data.ssaoLowBuffer);
+		glDeleteFramebuffers(2, data.ssaoLowBlurBuffer);
+	}
+	if (data.ssaoTemporal) {
+		data.targets.release(data.ssaoHistory[0]);
+		data.targets.release(data.ssaoHistory[1]);
+		glDeleteFramebuffers(2, data.ssaoHistoryBuffer);
+	}
 }
 
 glm::mat4 Resize(SDL_Manager & sdlm, RenderInfo & data) {
 	sdlm.refresh_size();
 	DeleteBuffers(data);
 	PrepareBuffers(sdlm.size.width, sdlm.size.height, data);
-	return glm::perspective(glm::radians(60.0f), sdlm.size.ratio, 0.5f, 1000.0f);
+	data.targets.delete_other_sizes();
+	return glm::perspective(glm::radians(60.0f), sdlm.size.ratio, NearPlane, FarPlane);
+}
+
+void DumpFrame(const std::string& path, SDL_Manager& sdlm) {
+	std::vector<unsigned char> pixels(sdlm.size.width * sdlm.size.height * 3);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, sdlm.output_framebuffer());
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, sdlm.size.width, sdlm.size.height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+	std::ofstream out(path, std::ios::binary);
+	if (!out) {
+		std::cerr << "Can't open " << path << " for writing\n";
+		throw std::runtime_error("Frame dump failed");
+	}
+
+	// Binary PPM, top row first where GL returns the bottom row first
+	out << "P6\n" << sdlm.size.width << ' ' << sdlm.size.height << "\n255\n";
+	size_t row = sdlm.size.width * 3;
+	for (size_t y = sdlm.size.height; y-- > 0;) {
+		out.write(reinterpret_cast<const char*>(pixels.data() + y * row), row);
+	}
 }
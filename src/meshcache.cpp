@@ -0,0 +1,423 @@
+#include "meshcache.hpp"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "meshopt.hpp"
+
+namespace {
+	constexpr char mesh_magic[8] = {'D', 'L', 'M', 'E', 'S', 'H', '\r', '\n'};
+
+	struct Source_Info {
+		bool exists;
+		std::uint64_t size;
+		std::int64_t mtime;
+	};
+
+	Source_Info stat_file(const std::string& name) {
+		struct stat st;
+		if (stat(name.c_str(), &st) != 0) {
+			return Source_Info{false, 0, 0};
+		}
+		return Source_Info{true, static_cast<std::uint64_t>(st.st_size), static_cast<std::int64_t>(st.st_mtime)};
+	}
+
+	// 64-bit FNV-1a
+	std::uint64_t hash_file(const std::string& name) {
+		Mapped_File file(name.c_str());
+
+		std::uint64_t hash = 0xcbf29ce484222325ULL;
+		for (std::size_t i = 0; i < file.size(); ++i) {
+			hash ^= static_cast<unsigned char>(file.data()[i]);
+			hash *= 0x100000001b3ULL;
+		}
+		return hash;
+	}
+
+	// Parse and run the at-load optimizations before the result is cached.
+	ObjFile build_mesh(const std::string& source) {
+		ObjFile file = parse_obj_file(source);
+
+		for (auto& obj : file.objects) {
+			auto stats = optimize_object(obj);
+			std::cerr << source << " " << obj.name << ": ACMR " << stats.acmr_before << " -> " << stats.acmr_after << '\n';
+		}
+
+		return file;
+	}
+
+	std::size_t align_up(std::size_t val, std::size_t alignment) {
+		return (val + alignment - 1) / alignment * alignment;
+	}
+
+	bool write_cache(const std::string& cache, const ObjFile& file, const Source_Info& info, std::uint64_t hash) {
+		Mesh_Header header;
+		std::memcpy(header.magic, mesh_magic, sizeof(mesh_magic));
+		header.version      = MESH_VERSION;
+		header.object_count = static_cast<std::uint32_t>(file.objects.size());
+		header.source_size  = info.size;
+		header.source_mtime = info.mtime;
+		header.source_hash  = hash;
+
+		std::vector<Mesh_Object_Entry> entries(file.objects.size());
+		std::string names;
+
+		std::size_t names_offset = sizeof(Mesh_Header) + entries.size() * sizeof(Mesh_Object_Entry);
+		for (std::size_t i = 0; i < file.objects.size(); ++i) {
+			entries[i].name_offset = names_offset + names.size();
+			names += file.objects[i].name;
+			names += '\0';
+		}
+
+		std::size_t offset = align_up(names_offset + names.size(), 16);
+		names.resize(offset - names_offset, '\0');
+		for (std::size_t i = 0; i < file.objects.size(); ++i) {
+			entries[i].vertex_offset = offset;
+			entries[i].vertex_count  = file.objects[i].vertices.size();
+			offset += file.objects[i].vertices.size() * sizeof(Vertex);
+		}
+		for (std::size_t i = 0; i < file.objects.size(); ++i) {
+			entries[i].index_offset = offset;
+			entries[i].index_count  = file.objects[i].indices.size();
+			entries[i].index_size   = mesh_index_size(file.objects[i].vertices.size());
+			offset += entries[i].index_count * entries[i].index_size;
+		}
+
+		// Write to the side and move into place so a crash never leaves a torn cache
+		std::string temp = cache + ".tmp";
+		{
+			std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+			if (!out) {
+				return false;
+			}
+
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Mesh_Object_Entry));
+			out.write(names.data(), names.size());
+			for (auto& obj : file.objects) {
+				out.write(reinterpret_cast<const char*>(obj.vertices.data()), obj.vertices.size() * sizeof(Vertex));
+			}
+			for (auto& obj : file.objects) {
+				if (mesh_index_size(obj.vertices.size()) == 2) {
+					std::vector<std::uint16_t> narrow(obj.indices.begin(), obj.indices.end());
+					out.write(reinterpret_cast<const char*>(narrow.data()), narrow.size() * sizeof(std::uint16_t));
+				}
+				else {
+					out.write(reinterpret_cast<const char*>(obj.indices.data()), obj.indices.size() * sizeof(std::uint32_t));
+				}
+			}
+
+			if (!out) {
+				out.close();
+				std::remove(temp.c_str());
+				return false;
+			}
+		}
+
+		std::remove(cache.c_str());
+		if (std::rename(temp.c_str(), cache.c_str()) != 0) {
+			std::remove(temp.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	// Records the source's new mtime in place, so a touched but unmodified source is only hashed once.
+	// Best effort, on failure the next load just hashes again.
+	void update_cache_mtime(const std::string& cache, std::int64_t mtime) {
+		std::fstream out(cache, std::ios::binary | std::ios::in | std::ios::out);
+		if (out) {
+			out.seekp(offsetof(Mesh_Header, source_mtime));
+			out.write(reinterpret_cast<const char*>(&mtime), sizeof(mtime));
+		}
+	}
+
+	// Point the object views into the mapping. Returns false if the cache is malformed.
+	bool read_cache(Mesh_File& mesh) {
+		const char* data = mesh.mapping.data();
+		std::size_t size = mesh.mapping.size();
+
+		if (size < sizeof(Mesh_Header)) {
+			return false;
+		}
+
+		const Mesh_Header& header = *reinterpret_cast<const Mesh_Header*>(data);
+		if (std::memcmp(header.magic, mesh_magic, sizeof(mesh_magic)) != 0 || header.version != MESH_VERSION) {
+			return false;
+		}
+		if (size < sizeof(Mesh_Header) + header.object_count * sizeof(Mesh_Object_Entry)) {
+			return false;
+		}
+
+		auto entries = reinterpret_cast<const Mesh_Object_Entry*>(data + sizeof(Mesh_Header));
+
+		mesh.objects.clear();
+		for (std::size_t i = 0; i < header.object_count; ++i) {
+			auto& e = entries[i];
+			if (e.name_offset >= size || std::memchr(data + e.name_offset, '\0', size - e.name_offset) == nullptr) {
+				return false;
+			}
+			if (e.vertex_offset % alignof(Vertex) != 0 || e.vertex_offset > size ||
+			    e.vertex_count > (size - e.vertex_offset) / sizeof(Vertex)) {
+				return false;
+			}
+			if (e.index_size != mesh_index_size(e.vertex_count) || e.index_offset % e.index_size != 0 ||
+			    e.index_offset > size || e.index_count > (size - e.index_offset) / e.index_size) {
+				return false;
+			}
+
+			mesh.objects.push_back(Mesh_Object{
+			    data + e.name_offset,                                    // name
+			    reinterpret_cast<const Vertex*>(data + e.vertex_offset), // vertices
+			    static_cast<std::size_t>(e.vertex_count),                // vertex count
+			    data + e.index_offset,                                   // indices
+			    static_cast<std::size_t>(e.index_count),                 // index count
+			    static_cast<std::size_t>(e.index_size)                   // index size
+			});
+		}
+
+		return true;
+	}
+
+	Mesh_File from_parsed(ObjFile&& file) {
+		Mesh_File mesh;
+		mesh.parsed = std::move(file);
+		for (auto& obj : mesh.parsed.objects) {
+			const void* indices    = obj.indices.data();
+			std::size_t index_size = mesh_index_size(obj.vertices.size());
+			if (index_size == 2) {
+				mesh.short_indices.emplace_back(obj.indices.begin(), obj.indices.end());
+				indices = mesh.short_indices.back().data();
+			}
+
+			mesh.objects.push_back(Mesh_Object{obj.name, obj.vertices.data(), obj.vertices.size(), indices,
+			                                   obj.indices.size(), index_size});
+		}
+		return mesh;
+	}
+
+	std::uint16_t float_to_half(float val) {
+		std::uint32_t bits;
+		std::memcpy(&bits, &val, sizeof(bits));
+
+		std::uint16_t sign = static_cast<std::uint16_t>((bits >> 16) & 0x8000);
+		std::int32_t exp   = static_cast<std::int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+		std::uint32_t mant = bits & 0x7FFFFF;
+
+		if (((bits >> 23) & 0xFF) == 0xFF) {
+			// Inf/NaN
+			return sign | 0x7C00 | (mant ? 0x200 : 0);
+		}
+		if (exp >= 0x1F) {
+			return sign | 0x7C00;
+		}
+		if (exp <= 0) {
+			// Denormal or zero
+			if (exp < -10) {
+				return sign;
+			}
+			mant |= 0x800000;
+			std::uint32_t shift = static_cast<std::uint32_t>(14 - exp);
+			std::uint32_t half  = mant >> shift;
+			std::uint32_t rest  = mant & ((1u << shift) - 1);
+			std::uint32_t mid   = 1u << (shift - 1);
+			if (rest > mid || (rest == mid && (half & 1))) {
+				half++;
+			}
+			return sign | static_cast<std::uint16_t>(half);
+		}
+
+		std::uint32_t half = (static_cast<std::uint32_t>(exp) << 10) | (mant >> 13);
+		std::uint32_t rest = mant & 0x1FFF;
+		if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+			// Carry may roll into the exponent, which is still correct
+			half++;
+		}
+		return sign | static_cast<std::uint16_t>(half);
+	}
+
+	float snorm16_to_float(std::int16_t val) {
+		return std::max(val / 32767.0f, -1.0f);
+	}
+
+	std::int16_t float_to_snorm16(float val) {
+		return static_cast<std::int16_t>(std::round(std::max(-1.0f, std::min(1.0f, val)) * 32767.0f));
+	}
+
+	// Matches oct_decode in shaders/geometry.v.glsl
+	void oct_decode(float ex, float ey, float out[3]) {
+		float z = 1.0f - std::abs(ex) - std::abs(ey);
+		float t = std::max(-z, 0.0f);
+		float x = ex + (ex >= 0.0f ? -t : t);
+		float y = ey + (ey >= 0.0f ? -t : t);
+
+		float len = std::sqrt(x * x + y * y + z * z);
+		out[0]    = x / len;
+		out[1]    = y / len;
+		out[2]    = z / len;
+	}
+
+	void oct_encode(float x, float y, float z, std::int16_t& ex, std::int16_t& ey) {
+		float l1 = std::abs(x) + std::abs(y) + std::abs(z);
+		if (l1 == 0.0f) {
+			ex = ey = 0;
+			return;
+		}
+		x /= l1;
+		y /= l1;
+
+		if (z < 0.0f) {
+			float ox = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			float oy = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x        = ox;
+			y        = oy;
+		}
+
+		ex = float_to_snorm16(x);
+		ey = float_to_snorm16(y);
+	}
+
+	void print_stats(const std::string& source, const Mesh_File& mesh) {
+		for (auto& obj : mesh.objects) {
+			std::size_t before = obj.index_count * sizeof(Vertex);
+			std::size_t after  = obj.vertex_count * sizeof(Vertex) + obj.index_count * obj.index_size;
+			std::cerr << source << " " << obj.name << ": " << obj.index_count << " -> " << obj.vertex_count
+			          << " vertices, " << before / 1024 << "KB -> " << after / 1024 << "KB\n";
+		}
+	}
+} // namespace
+
+Packed_Object pack_object(const Mesh_Object& obj) {
+	Packed_Object packed;
+	packed.max_position_error = 0;
+	packed.max_normal_error   = 0;
+
+	/////////////////////
+	// Position Bounds //
+	/////////////////////
+
+	float min[3] = {0, 0, 0}, max[3] = {0, 0, 0};
+	for (std::size_t i = 0; i < obj.vertex_count; ++i) {
+		const float* pos = &obj.vertices[i].x;
+		for (std::size_t k = 0; k < 3; ++k) {
+			min[k] = i == 0 ? pos[k] : std::min(min[k], pos[k]);
+			max[k] = i == 0 ? pos[k] : std::max(max[k], pos[k]);
+		}
+	}
+	for (std::size_t k = 0; k < 3; ++k) {
+		packed.bias[k]  = min[k];
+		packed.scale[k] = max[k] > min[k] ? max[k] - min[k] : 1.0f;
+	}
+
+	////////////
+	// Encode //
+	////////////
+
+	packed.vertices.reserve(obj.vertex_count);
+	for (std::size_t i = 0; i < obj.vertex_count; ++i) {
+		const Vertex& v = obj.vertices[i];
+		const float* pos = &v.x;
+
+		Packed_Vertex p;
+		std::uint16_t* qpos = &p.x;
+		for (std::size_t k = 0; k < 3; ++k) {
+			float unorm = (pos[k] - packed.bias[k]) / packed.scale[k];
+			qpos[k]     = static_cast<std::uint16_t>(std::round(std::max(0.0f, std::min(1.0f, unorm)) * 65535.0f));
+
+			float decoded             = qpos[k] / 65535.0f * packed.scale[k] + packed.bias[k];
+			packed.max_position_error = std::max(packed.max_position_error, std::abs(decoded - pos[k]));
+		}
+		p.pad = 0;
+
+		oct_encode(v.nx, v.ny, v.nz, p.nx, p.ny);
+
+		float len = std::sqrt(v.nx * v.nx + v.ny * v.ny + v.nz * v.nz);
+		if (len > 0.0f) {
+			float n[3];
+			oct_decode(snorm16_to_float(p.nx), snorm16_to_float(p.ny), n);
+			float cos_angle         = std::min(1.0f, (n[0] * v.nx + n[1] * v.ny + n[2] * v.nz) / len);
+			packed.max_normal_error = std::max(packed.max_normal_error, std::acos(cos_angle) * 57.2957795f);
+		}
+
+		p.tx = float_to_half(v.tx);
+		p.ty = float_to_half(v.ty);
+
+		packed.vertices.push_back(p);
+	}
+
+	return packed;
+}
+
+std::size_t mesh_index_size(std::size_t vertex_count) {
+	return vertex_count <= 0x10000 ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+}
+
+std::string mesh_cache_name(const std::string& source) {
+	return source + ".mesh";
+}
+
+Mesh_File load_mesh(const std::string& source) {
+	std::string cache   = mesh_cache_name(source);
+	Source_Info info    = stat_file(source);
+	Source_Info on_disk = stat_file(cache);
+
+	// Only hashed when size matches but mtime doesn't, and reused if the cache is rebuilt
+	bool hashed               = false;
+	std::uint64_t source_hash = 0;
+
+	if (on_disk.exists) {
+		Mesh_File mesh;
+		mesh.mapping = Mapped_File(cache.c_str());
+
+		if (mesh.mapping.is_open() && read_cache(mesh)) {
+			auto& header = *reinterpret_cast<const Mesh_Header*>(mesh.mapping.data());
+
+			// A missing source means the cache was shipped on its own
+			bool fresh = !info.exists || (header.source_size == info.size && header.source_mtime == info.mtime);
+			if (!fresh && header.source_size == info.size) {
+				// Touched but maybe not modified
+				source_hash = hash_file(source);
+				hashed      = true;
+				if (header.source_hash == source_hash) {
+					update_cache_mtime(cache, info.mtime);
+					fresh = true;
+				}
+			}
+
+			if (fresh) {
+				print_stats(source, mesh);
+				return mesh;
+			}
+		}
+	}
+
+	std::cerr << "Building mesh cache " << cache << '\n';
+
+	ObjFile file = build_mesh(source);
+
+	if (!hashed) {
+		source_hash = hash_file(source);
+	}
+	if (!write_cache(cache, file, info, source_hash)) {
+		std::cerr << "Couldn't write mesh cache " << cache << '\n';
+	}
+
+	auto mesh = from_parsed(std::move(file));
+	print_stats(source, mesh);
+	return mesh;
+}
+
+bool convert_mesh(const std::string& source) {
+	Source_Info info = stat_file(source);
+	ObjFile file     = build_mesh(source);
+
+	return write_cache(mesh_cache_name(source), file, info, hash_file(source));
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "objparser.hpp"
+#include "util.hpp"
+
+// Binary precompiled mesh format (.mesh), written next to the .wavobj it was built from.
+//
+// Layout:
+//   Mesh_Header
+//   Mesh_Object_Entry[object_count]
+//   name table (NUL terminated strings)
+//   vertex blob (tightly packed Vertex, 16 byte aligned)
+//   index blob (uint16 for objects with at most 65536 vertices, uint32 otherwise)
+//
+// Files are native endian; the magic doubles as an endianness check.
+
+constexpr std::uint32_t MESH_VERSION = 3;
+
+struct Mesh_Header {
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t object_count;
+	std::uint64_t source_size;
+	std::int64_t source_mtime;
+	std::uint64_t source_hash;
+};
+
+struct Mesh_Object_Entry {
+	std::uint64_t name_offset;   // Bytes from start of file
+	std::uint64_t vertex_offset; // Bytes from start of file
+	std::uint64_t vertex_count;
+	std::uint64_t index_offset; // Bytes from start of file
+	std::uint64_t index_count;
+	std::uint64_t index_size; // 2 or 4
+};
+
+// A view of a single object, pointing either into the mapped cache or parsed data.
+struct Mesh_Object {
+	std::string name;
+	const Vertex* vertices;
+	std::size_t vertex_count;
+	const void* indices;
+	std::size_t index_count;
+	std::size_t index_size;
+};
+
+struct Mesh_File {
+	std::vector<Mesh_Object> objects;
+
+	// Backing storage for the views above. Only one is in use.
+	Mapped_File mapping;
+	ObjFile parsed;
+	std::vector<std::vector<std::uint16_t>> short_indices;
+};
+
+// Objects with few enough vertices store 16-bit indices.
+std::size_t mesh_index_size(std::size_t vertex_count);
+
+// Quantized vertex: 16 bytes instead of 32.
+struct Packed_Vertex {
+	std::uint16_t x, y, z; // unorm16 within the object's bounds
+	std::uint16_t pad;
+	std::int16_t nx, ny;   // snorm16 octahedral encoded normal
+	std::uint16_t tx, ty;  // half float texcoords
+};
+
+struct Packed_Object {
+	std::vector<Packed_Vertex> vertices;
+
+	// position = unorm * scale + bias
+	float scale[3];
+	float bias[3];
+
+	float max_position_error; // Object space units
+	float max_normal_error;   // Degrees
+};
+
+// Quantizes obj for packed_vertex_layout and measures the worst case error introduced.
+Packed_Object pack_object(const Mesh_Object& obj);
+
+// Loads source through its cache, rebuilding the cache when it's missing or stale.
+Mesh_File load_mesh(const std::string& source);
+
+// Parses and optimizes source and writes its cache unconditionally. Returns false if writing failed.
+bool convert_mesh(const std::string& source);
+
+std::string mesh_cache_name(const std::string& source);
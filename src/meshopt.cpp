@@ -0,0 +1,332 @@
+#include "meshopt.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+	// Forsyth's tuning values, see https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+	constexpr std::size_t max_cache_size = 32;
+	constexpr float cache_decay_power    = 1.5f;
+	constexpr float last_tri_score       = 0.75f;
+	constexpr float valence_boost_scale  = 2.0f;
+	constexpr float valence_boost_power  = 0.5f;
+
+	constexpr std::uint32_t not_in_cache = std::numeric_limits<std::uint32_t>::max();
+
+	float vertex_score(std::uint32_t cache_position, std::uint32_t remaining) {
+		if (remaining == 0) {
+			return -1.0f;
+		}
+
+		float score = 0.0f;
+		if (cache_position != not_in_cache) {
+			if (cache_position < 3) {
+				// The last triangle's vertices get a fixed score so it isn't simply repeated
+				score = last_tri_score;
+			}
+			else {
+				constexpr float scaler = 1.0f / (max_cache_size - 3);
+				score = std::pow(1.0f - (cache_position - 3) * scaler, cache_decay_power);
+			}
+		}
+
+		// Favour vertices with few triangles left so they can leave the cache for good
+		score += valence_boost_scale * std::pow(static_cast<float>(remaining), -valence_boost_power);
+		return score;
+	}
+
+	struct Vec3 {
+		float x, y, z;
+	};
+
+	Vec3 position(const Vertex& v) {
+		return Vec3{v.x, v.y, v.z};
+	}
+} // namespace
+
+float calculate_acmr(const std::vector<std::uint32_t>& indices, std::size_t vertex_count, std::size_t cache_size) {
+	if (indices.size() < 3) {
+		return 0.0f;
+	}
+
+	// Timestamp of when each vertex entered the FIFO
+	std::vector<std::size_t> entered(vertex_count, 0);
+	std::size_t time   = cache_size + 1;
+	std::size_t misses = 0;
+
+	for (auto i : indices) {
+		if (time - entered[i] > cache_size) {
+			entered[i] = time++;
+			misses++;
+		}
+	}
+
+	return static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+}
+
+void optimize_vertex_cache(std::vector<std::uint32_t>& indices, std::size_t vertex_count) {
+	std::size_t tri_count = indices.size() / 3;
+	if (tri_count == 0) {
+		return;
+	}
+
+	/////////////////////////
+	// Vertex -> Triangles //
+	/////////////////////////
+
+	std::vector<std::uint32_t> remaining(vertex_count, 0);
+	for (auto i : indices) {
+		remaining[i]++;
+	}
+
+	std::vector<std::uint32_t> adjacency_offset(vertex_count + 1, 0);
+	for (std::size_t v = 0; v < vertex_count; ++v) {
+		adjacency_offset[v + 1] = adjacency_offset[v] + remaining[v];
+	}
+
+	std::vector<std::uint32_t> adjacency(indices.size());
+	{
+		std::vector<std::uint32_t> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+		for (std::size_t t = 0; t < tri_count; ++t) {
+			for (std::size_t k = 0; k < 3; ++k) {
+				adjacency[fill[indices[t * 3 + k]]++] = static_cast<std::uint32_t>(t);
+			}
+		}
+	}
+
+	////////////////////
+	// Initial Scores //
+	////////////////////
+
+	std::vector<std::uint32_t> cache_position(vertex_count, not_in_cache);
+	std::vector<float> vscore(vertex_count);
+	for (std::size_t v = 0; v < vertex_count; ++v) {
+		vscore[v] = vertex_score(not_in_cache, remaining[v]);
+	}
+
+	std::vector<float> tscore(tri_count);
+	std::vector<bool> emitted(tri_count, false);
+	for (std::size_t t = 0; t < tri_count; ++t) {
+		tscore[t] = vscore[indices[t * 3]] + vscore[indices[t * 3 + 1]] + vscore[indices[t * 3 + 2]];
+	}
+
+	////////////////////
+	// Emit Triangles //
+	////////////////////
+
+	std::vector<std::uint32_t> output;
+	output.reserve(indices.size());
+
+	std::vector<std::uint32_t> cache, new_cache;
+	cache.reserve(max_cache_size + 3);
+	new_cache.reserve(max_cache_size + 3);
+
+	std::size_t best        = std::max_element(tscore.begin(), tscore.end()) - tscore.begin();
+	std::size_t scan_cursor = 0;
+
+	for (std::size_t n = 0; n < tri_count; ++n) {
+		if (best == tri_count) {
+			// Nothing in the cache touches a live triangle, start on the best remaining one
+			while (emitted[scan_cursor]) {
+				scan_cursor++;
+			}
+			best = scan_cursor;
+			for (std::size_t t = scan_cursor; t < tri_count; ++t) {
+				if (!emitted[t] && tscore[t] > tscore[best]) {
+					best = t;
+				}
+			}
+		}
+
+		const std::uint32_t* tri = &indices[best * 3];
+		output.insert(output.end(), tri, tri + 3);
+		emitted[best] = true;
+
+		// Remove the triangle from its vertices' lists
+		for (std::size_t k = 0; k < 3; ++k) {
+			std::uint32_t v      = tri[k];
+			std::uint32_t* begin = &adjacency[adjacency_offset[v]];
+			std::uint32_t* end   = begin + remaining[v];
+			*std::find(begin, end, static_cast<std::uint32_t>(best)) = *(end - 1);
+			remaining[v]--;
+		}
+
+		// Move the triangle's vertices to the front of the LRU cache
+		new_cache.assign(tri, tri + 3);
+		for (auto v : cache) {
+			if (v != tri[0] && v != tri[1] && v != tri[2]) {
+				new_cache.push_back(v);
+			}
+		}
+
+		for (std::size_t c = 0; c < new_cache.size(); ++c) {
+			cache_position[new_cache[c]] = c < max_cache_size ? static_cast<std::uint32_t>(c) : not_in_cache;
+		}
+		for (auto v : new_cache) {
+			vscore[v] = vertex_score(cache_position[v], remaining[v]);
+		}
+
+		// Rescore every triangle touching the cache and pick the next one among them
+		best             = tri_count;
+		float best_score = -std::numeric_limits<float>::infinity();
+		for (auto v : new_cache) {
+			for (std::uint32_t a = 0; a < remaining[v]; ++a) {
+				std::uint32_t t = adjacency[adjacency_offset[v] + a];
+				tscore[t]       = vscore[indices[t * 3]] + vscore[indices[t * 3 + 1]] + vscore[indices[t * 3 + 2]];
+				if (tscore[t] > best_score) {
+					best_score = tscore[t];
+					best       = t;
+				}
+			}
+		}
+
+		if (new_cache.size() > max_cache_size) {
+			new_cache.resize(max_cache_size);
+		}
+		std::swap(cache, new_cache);
+	}
+
+	indices = std::move(output);
+}
+
+void optimize_overdraw(std::vector<std::uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold) {
+	constexpr std::size_t cache_size = 16;
+
+	std::size_t tri_count = indices.size() / 3;
+	if (tri_count < 2) {
+		return;
+	}
+
+	/////////////////////
+	// Split Into Runs //
+	/////////////////////
+
+	// A triangle missing all three vertices means the cache started over,
+	// so clusters can be reordered there without costing vertex reuse.
+	std::vector<std::size_t> clusters;
+	{
+		std::vector<std::size_t> entered(vertices.size(), 0);
+		std::size_t time = cache_size + 1;
+
+		for (std::size_t t = 0; t < tri_count; ++t) {
+			std::size_t misses = 0;
+			for (std::size_t k = 0; k < 3; ++k) {
+				auto i = indices[t * 3 + k];
+				if (time - entered[i] > cache_size) {
+					entered[i] = time++;
+					misses++;
+				}
+			}
+			if (misses == 3) {
+				clusters.push_back(t);
+			}
+		}
+	}
+	clusters.push_back(tri_count);
+
+	if (clusters.size() <= 2) {
+		return;
+	}
+
+	///////////////////
+	// Sort Clusters //
+	///////////////////
+
+	Vec3 mesh_center{0, 0, 0};
+	for (auto& v : vertices) {
+		mesh_center.x += v.x;
+		mesh_center.y += v.y;
+		mesh_center.z += v.z;
+	}
+	mesh_center.x /= vertices.size();
+	mesh_center.y /= vertices.size();
+	mesh_center.z /= vertices.size();
+
+	struct Cluster {
+		std::size_t begin, end;
+		float key;
+	};
+
+	std::vector<Cluster> sorted;
+	sorted.reserve(clusters.size() - 1);
+	for (std::size_t c = 0; c + 1 < clusters.size(); ++c) {
+		Vec3 center{0, 0, 0}, normal{0, 0, 0};
+		float area = 0;
+
+		for (std::size_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+			Vec3 a = position(vertices[indices[t * 3]]);
+			Vec3 b = position(vertices[indices[t * 3 + 1]]);
+			Vec3 d = position(vertices[indices[t * 3 + 2]]);
+
+			Vec3 e1{b.x - a.x, b.y - a.y, b.z - a.z};
+			Vec3 e2{d.x - a.x, d.y - a.y, d.z - a.z};
+			Vec3 n{e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x};
+			float tri_area = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+
+			center.x += (a.x + b.x + d.x) / 3 * tri_area;
+			center.y += (a.y + b.y + d.y) / 3 * tri_area;
+			center.z += (a.z + b.z + d.z) / 3 * tri_area;
+			normal.x += n.x;
+			normal.y += n.y;
+			normal.z += n.z;
+			area += tri_area;
+		}
+
+		float key = 0;
+		if (area > 0) {
+			center.x /= area;
+			center.y /= area;
+			center.z /= area;
+			float len = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+			if (len > 0) {
+				key = ((center.x - mesh_center.x) * normal.x + (center.y - mesh_center.y) * normal.y +
+				       (center.z - mesh_center.z) * normal.z) /
+				      len;
+			}
+		}
+
+		sorted.push_back(Cluster{clusters[c], clusters[c + 1], key});
+	}
+
+	// Clusters facing away from the center occlude the rest, draw them first
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.key > b.key; });
+
+	std::vector<std::uint32_t> output;
+	output.reserve(indices.size());
+	for (auto& c : sorted) {
+		output.insert(output.end(), indices.begin() + c.begin * 3, indices.begin() + c.end * 3);
+	}
+
+	if (calculate_acmr(output, vertices.size()) <= calculate_acmr(indices, vertices.size()) * threshold) {
+		indices = std::move(output);
+	}
+}
+
+void optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<std::uint32_t>& indices) {
+	std::vector<std::uint32_t> remap(vertices.size(), not_in_cache);
+	std::vector<Vertex> output;
+	output.reserve(vertices.size());
+
+	for (auto& i : indices) {
+		if (remap[i] == not_in_cache) {
+			remap[i] = static_cast<std::uint32_t>(output.size());
+			output.push_back(vertices[i]);
+		}
+		i = remap[i];
+	}
+
+	vertices = std::move(output);
+}
+
+Optimize_Stats optimize_object(Object& obj) {
+	Optimize_Stats stats;
+	stats.acmr_before = calculate_acmr(obj.indices, obj.vertices.size());
+
+	optimize_vertex_cache(obj.indices, obj.vertices.size());
+	optimize_overdraw(obj.indices, obj.vertices);
+	optimize_vertex_fetch(obj.vertices, obj.indices);
+
+	stats.acmr_after = calculate_acmr(obj.indices, obj.vertices.size());
+	return stats;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "objparser.hpp"
+
+// Average cache miss ratio (transformed vertices per triangle) with a FIFO post-transform cache.
+float calculate_acmr(const std::vector<std::uint32_t>& indices, std::size_t vertex_count, std::size_t cache_size = 16);
+
+// Reorders triangles for post-transform cache locality (Forsyth's linear-speed algorithm).
+void optimize_vertex_cache(std::vector<std::uint32_t>& indices, std::size_t vertex_count);
+
+// Reorders clusters of triangles so outward facing ones are drawn first, reducing overdraw.
+// Keeps the original order if the ACMR gets worse than threshold times the original.
+void optimize_overdraw(std::vector<std::uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+
+// Reorders vertices in the order the index buffer first uses them, for vertex fetch locality.
+void optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<std::uint32_t>& indices);
+
+struct Optimize_Stats {
+	float acmr_before;
+	float acmr_after;
+};
+
+// Runs all of the above in order on an object.
+Optimize_Stats optimize_object(Object& obj);
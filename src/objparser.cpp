@@ -1,157 +1,560 @@
 #include "objparser.hpp"
 
-#include <sstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
-#include <tuple>
+#include <thread>
 
 #include "util.hpp"
 
-ObjFile parse_obj_file(std::string name) {
-	auto raw_file = file_contents(name.c_str());
+namespace {
+	// Chunks smaller than this aren't worth a thread
+	constexpr std::size_t min_chunk_size = 64 * 1024;
 
-	ObjFile file;
+	struct Position {
+		float x, y, z;
+	};
 
-	size_t line = 1;
+	struct Texcoord {
+		float x, y;
+	};
 
-	auto error_impl = [&line](const char* val, size_t fileline) {
-		std::stringstream print;
-		print << line << ": .obj parsing failed on line " << fileline << ": " << val << '\n';
-		std::cerr << print.str();
-		throw std::runtime_error(print.str().c_str());
+	// 1-based indices into the position/texcoord/normal tables. 0 is missing.
+	struct Corner {
+		std::size_t v, vt, vn;
 	};
 
-#define error(v) error_impl(v, __LINE__)
+	// An 'o' line. The object owns every corner from corner_offset on.
+	struct Object_Start {
+		std::string name;
+		std::size_t corner_offset;
+	};
 
-	std::istringstream fs(raw_file);
+	struct Chunk {
+		const char* begin;
+		const char* end;
 
-	if (!fs) {
-		std::cerr << "Couldn't open file " << name << '\n';
-		throw std::runtime_error("File opening failed");
+		std::vector<Position> vertices;
+		std::vector<Texcoord> texcoords;
+		std::vector<Position> normals;
+		std::vector<Corner> corners;
+		std::vector<Object_Start> objects;
+
+		std::size_t lines = 0;
+
+		const char* error       = nullptr;
+		std::size_t error_line  = 0;
+		std::size_t error_fline = 0;
+	};
+
+	bool is_blank(char c) {
+		return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
 	}
 
-	std::vector<std::tuple<float, float, float>> vertices;
-	std::vector<std::tuple<float, float>> texcoords;
-	std::vector<std::tuple<float, float, float>> normals;
+	bool is_digit(char c) {
+		return c >= '0' && c <= '9';
+	}
 
-	while (!fs.eof()) {
-		// Start of line
-		char c;
-		c = fs.get();
-		switch (c) {
-			// Skip comment line by fallthrough
+	void skip_blanks(const char*& p, const char* end) {
+		while (p < end && is_blank(*p)) {
+			++p;
+		}
+	}
 
-			// Object name
-			case 'o': {
-				std::string name;
-				fs >> name;
+	// Locale-free unsigned integer scanner.
+	bool scan_index(const char*& p, const char* end, std::size_t& out) {
+		skip_blanks(p, end);
+		if (p < end && *p == '+') {
+			++p;
+		}
+		if (p == end || !is_digit(*p)) {
+			return false;
+		}
 
-				file.objects.push_back(Object{std::move(name), {}});
-				break;
+		std::size_t val = 0;
+		while (p < end && is_digit(*p)) {
+			val = val * 10 + static_cast<std::size_t>(*p - '0');
+			++p;
+		}
+		out = val;
+		return true;
+	}
+
+	// Locale-free float scanner. Values whose decimal mantissa fits in 24 bits and whose
+	// power of ten is exactly representable are computed with a single correctly rounded
+	// float operation, which covers everything blender exports. Anything else falls back
+	// to strtof so results are always identical to what istream extraction gave us.
+	bool scan_float(const char*& p, const char* end, float& out) {
+		constexpr float pow10[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+		skip_blanks(p, end);
+		const char* start = p;
+
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			++p;
+		}
+
+		std::uint64_t mantissa = 0;
+		int exponent           = 0;
+		std::size_t digits     = 0;
+		bool truncated         = false;
+
+		while (p < end && is_digit(*p)) {
+			if (mantissa < (UINT64_MAX - 9) / 10) {
+				mantissa = mantissa * 10 + static_cast<std::uint64_t>(*p - '0');
+			}
+			else {
+				exponent += 1;
+				truncated = true;
+			}
+			++digits;
+			++p;
+		}
+		if (p < end && *p == '.') {
+			++p;
+			while (p < end && is_digit(*p)) {
+				if (mantissa < (UINT64_MAX - 9) / 10) {
+					mantissa = mantissa * 10 + static_cast<std::uint64_t>(*p - '0');
+					exponent -= 1;
+				}
+				else {
+					truncated = true;
+				}
+				++digits;
+				++p;
+			}
+		}
+		if (digits == 0) {
+			p = start;
+			return false;
+		}
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			const char* exp_start = p;
+			++p;
+			bool exp_negative = false;
+			if (p < end && (*p == '-' || *p == '+')) {
+				exp_negative = *p == '-';
+				++p;
 			}
+			if (p == end || !is_digit(*p)) {
+				p = exp_start;
+			}
+			else {
+				int exp_val = 0;
+				while (p < end && is_digit(*p)) {
+					exp_val = std::min(exp_val * 10 + (*p - '0'), 100000);
+					++p;
+				}
+				exponent += exp_negative ? -exp_val : exp_val;
+			}
+		}
 
-			// Parse a vertex
-			case 'v': {
-				c = fs.get();
-				switch (c) {
-					case ' ': {
-						float x, y, z;
-						bool fail = false;
+		if (!truncated && mantissa <= (1u << 24) && exponent >= -10 && exponent <= 10) {
+			float val = static_cast<float>(mantissa);
+			val       = exponent < 0 ? val / pow10[-exponent] : val * pow10[exponent];
+			out       = negative ? -val : val;
+			return true;
+		}
 
-						fail |= !(fs >> x);
-						fail |= !(fs >> y);
-						fail |= !(fs >> z);
+		// Slow path. The program never calls setlocale, so strtof sees the "C" locale.
+		char buffer[128];
+		std::size_t len = std::min<std::size_t>(static_cast<std::size_t>(p - start), sizeof(buffer) - 1);
+		std::memcpy(buffer, start, len);
+		buffer[len] = '\0';
+		out         = std::strtof(buffer, nullptr);
+		return true;
+	}
 
-						if (fail) {
-							error("Couldn't find vertex values");
-						}
+	// Parse every line in [chunk.begin, chunk.end) into chunk local tables.
+	// Face indices are left unresolved as they refer to the global tables.
+	void parse_chunk(Chunk& chunk) {
+		const char* p   = chunk.begin;
+		const char* end = chunk.end;
+
+		auto error_impl = [&chunk](const char* val, std::size_t fileline) {
+			chunk.error       = val;
+			chunk.error_line  = chunk.lines + 1;
+			chunk.error_fline = fileline;
+		};
+
+#define error(v)                   \
+	do {                           \
+		error_impl(v, __LINE__);   \
+		return;                    \
+	} while (0)
+
+		while (p < end) {
+			const char* line_end = static_cast<const char*>(std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+			if (line_end == nullptr) {
+				line_end = end;
+			}
 
-						vertices.emplace_back(x, y, z);
-						break;
+			// Start of line
+			switch (*p) {
+				// Skip comment line by fallthrough
+
+				// Object name
+				case 'o': {
+					const char* name = p + 1;
+					skip_blanks(name, line_end);
+					const char* name_end = name;
+					while (name_end < line_end && !is_blank(*name_end)) {
+						++name_end;
 					}
 
-					case 't': {
-						float tx, ty;
-						bool fail = false;
+					chunk.objects.push_back(Object_Start{std::string(name, name_end), chunk.corners.size()});
+					break;
+				}
+
+				// Parse a vertex
+				case 'v': {
+					const char* cur = p + 2;
+					switch (p + 1 < line_end ? p[1] : '\0') {
+						case ' ': {
+							Position pos;
+							bool fail = false;
 
-						fail |= !(fs >> tx);
-						fail |= !(fs >> ty);
+							fail |= !scan_float(cur, line_end, pos.x);
+							fail |= !scan_float(cur, line_end, pos.y);
+							fail |= !scan_float(cur, line_end, pos.z);
 
-						if (fail) {
-							error("Couldn't find texture values");
+							if (fail) {
+								error("Couldn't find vertex values");
+							}
+
+							chunk.vertices.push_back(pos);
+							break;
 						}
 
-						texcoords.emplace_back(tx, ty);
-						break;
-					}
+						case 't': {
+							Texcoord tex;
+							bool fail = false;
+
+							fail |= !scan_float(cur, line_end, tex.x);
+							fail |= !scan_float(cur, line_end, tex.y);
+
+							if (fail) {
+								error("Couldn't find texture values");
+							}
+
+							chunk.texcoords.push_back(tex);
+							break;
+						}
 
-					case 'n': {
-						float nx, ny, nz;
-						bool fail = false;
+						case 'n': {
+							Position norm;
+							bool fail = false;
 
-						fail |= !(fs >> nx);
-						fail |= !(fs >> ny);
-						fail |= !(fs >> nz);
+							fail |= !scan_float(cur, line_end, norm.x);
+							fail |= !scan_float(cur, line_end, norm.y);
+							fail |= !scan_float(cur, line_end, norm.z);
 
-						if (fail) {
-							error("Couldn't find normal coordinates");
+							if (fail) {
+								error("Couldn't find normal coordinates");
+							}
+
+							chunk.normals.push_back(norm);
+							break;
 						}
 
-						normals.emplace_back(nx, ny, nz);
-						break;
+						default: {
+							error("Unknown argument to v");
+							break;
+						}
 					}
+					break;
+				}
+
+				// Create a face
+				case 'f': {
+					const char* cur = p + 1;
+					// Get each set of vertexes
+					for (std::size_t i = 0; i < 3; ++i) {
+						Corner corner{0, 0, 0};
 
-					default: {
-						error("Unknown argument to v");
-						break;
+						if (!scan_index(cur, line_end, corner.v) || corner.v == 0) {
+							error("Vertex index not found");
+						}
+						if (cur < line_end && *cur == '/') {
+							++cur;
+							if (cur < line_end && is_digit(*cur)) {
+								scan_index(cur, line_end, corner.vt);
+							}
+							if (cur < line_end && *cur == '/') {
+								++cur;
+								if (cur < line_end && is_digit(*cur)) {
+									scan_index(cur, line_end, corner.vn);
+								}
+							}
+						}
+
+						chunk.corners.push_back(corner);
 					}
+					break;
 				}
-				break;
 			}
 
-			// Create a face
-			case 'f': {
-				// Get each set of vertexes
-				for (size_t i = 0; i < 3; ++i) {
-					size_t vindex, vtindex, vnindex;
-					bool vfail, vtfail, vnfail;
+			p = line_end + 1;
+			chunk.lines++;
+		}
+
+#undef error
+	}
+
+	// Split the file into roughly equal chunks that start at the beginning of a line.
+	std::vector<Chunk> split_chunks(const char* data, std::size_t size, std::size_t count) {
+		std::vector<Chunk> chunks;
+		chunks.reserve(count);
+
+		const char* end   = data + size;
+		const char* begin = data;
+		for (std::size_t i = 0; i < count && begin < end; ++i) {
+			const char* split = (i == count - 1) ? end : std::min(end, begin + size / count);
+			if (split < end) {
+				const char* newline = static_cast<const char*>(std::memchr(split, '\n', static_cast<std::size_t>(end - split)));
+				split               = newline ? newline + 1 : end;
+			}
+
+			Chunk chunk;
+			chunk.begin = begin;
+			chunk.end   = split;
+			chunks.push_back(std::move(chunk));
+
+			begin = split;
+		}
 
-					vfail = !(fs >> vindex);
-					if (vfail) {
-						error("Vertex index not found");
+		return chunks;
+	}
+
+	// Open addressing hash map from a (v, vt, vn) triple to the vertex it was emitted as.
+	class Corner_Map {
+	  public:
+		explicit Corner_Map(std::size_t expected) {
+			std::size_t capacity = 16;
+			while (capacity < expected * 2) {
+				capacity <<= 1;
+			}
+			slots.resize(capacity);
+			mask = capacity - 1;
+		}
+
+		// Leaves index untouched and returns true if corner wasn't seen before,
+		// otherwise replaces index with the existing vertex and returns false.
+		bool insert(const Corner& corner, std::uint32_t& index) {
+			std::size_t h = hash(corner) & mask;
+			while (true) {
+				Slot& slot = slots[h];
+				if (slot.index == empty) {
+					slot.key   = corner;
+					slot.index = index;
+					return true;
+				}
+				if (slot.key.v == corner.v && slot.key.vt == corner.vt && slot.key.vn == corner.vn) {
+					index = slot.index;
+					return false;
+				}
+				h = (h + 1) & mask;
+			}
+		}
+
+	  private:
+		static constexpr std::uint32_t empty = 0xFFFFFFFF;
+
+		struct Slot {
+			Corner key;
+			std::uint32_t index = empty;
+		};
+
+		static std::size_t hash(const Corner& c) {
+			std::uint64_t h = c.v * 0x9E3779B97F4A7C15ULL;
+			h ^= c.vt * 0xC2B2AE3D27D4EB4FULL;
+			h ^= c.vn * 0x165667B19E3779F9ULL;
+			return static_cast<std::size_t>(h ^ (h >> 29));
+		}
+
+		std::vector<Slot> slots;
+		std::size_t mask;
+	};
+
+	template <class Func>
+	void run_parallel(std::size_t count, Func&& func) {
+		std::vector<std::thread> threads;
+		threads.reserve(count ? count - 1 : 0);
+		for (std::size_t i = 1; i < count; ++i) {
+			threads.emplace_back(func, i);
+		}
+		if (count) {
+			func(0);
+		}
+		for (auto& t : threads) {
+			t.join();
+		}
+	}
+} // namespace
+
+ObjFile parse_obj_file(std::string name, std::size_t threads) {
+	Mapped_File raw_file(name.c_str());
+
+	if (!raw_file.is_open()) {
+		std::cerr << "Couldn't open file " << name << '\n';
+		throw std::runtime_error("File opening failed");
+	}
+
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	threads = std::max<std::size_t>(1, std::min(threads, raw_file.size() / min_chunk_size));
+
+	//////////////////////////////
+	// Parse Chunks in Parallel //
+	//////////////////////////////
+
+	auto chunks = split_chunks(raw_file.data(), raw_file.size(), threads);
+
+	run_parallel(chunks.size(), [&chunks](std::size_t i) { parse_chunk(chunks[i]); });
+
+	std::size_t line = 0;
+	for (auto& chunk : chunks) {
+		if (chunk.error) {
+			std::stringstream print;
+			print << line + chunk.error_line << ": .obj parsing failed on line " << chunk.error_fline << ": " << chunk.error << '\n';
+			std::cerr << print.str();
+			throw std::runtime_error(print.str().c_str());
+		}
+		line += chunk.lines;
+	}
+
+	//////////////////
+	// Merge Tables //
+	//////////////////
+
+	std::size_t vertex_count = 0, texcoord_count = 0, normal_count = 0;
+	for (auto& chunk : chunks) {
+		vertex_count += chunk.vertices.size();
+		texcoord_count += chunk.texcoords.size();
+		normal_count += chunk.normals.size();
+	}
+
+	std::vector<Position> vertices;
+	std::vector<Texcoord> texcoords;
+	std::vector<Position> normals;
+	vertices.reserve(vertex_count);
+	texcoords.reserve(texcoord_count);
+	normals.reserve(normal_count);
+
+	for (auto& chunk : chunks) {
+		vertices.insert(vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+		texcoords.insert(texcoords.end(), chunk.texcoords.begin(), chunk.texcoords.end());
+		normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+	}
+
+	/////////////////////
+	// Lay Out Objects //
+	/////////////////////
+
+	// A chunk's run of corners belonging to one object.
+	struct Segment {
+		std::size_t chunk;
+		std::size_t corner_begin, corner_end;
+	};
+
+	ObjFile file;
+	std::vector<std::vector<Segment>> object_segments;
+	std::vector<std::size_t> object_sizes;
+
+	for (std::size_t c = 0; c < chunks.size(); ++c) {
+		auto& chunk = chunks[c];
+		std::size_t corner = 0;
+
+		for (std::size_t o = 0; o <= chunk.objects.size(); ++o) {
+			std::size_t corner_end = o < chunk.objects.size() ? chunk.objects[o].corner_offset : chunk.corners.size();
+
+			if (corner_end != corner) {
+				// Faces before any object go to an unnamed one
+				if (file.objects.empty()) {
+					file.objects.push_back(Object{std::string(), {}, {}});
+					object_segments.emplace_back();
+					object_sizes.push_back(0);
+				}
+				object_segments.back().push_back(Segment{c, corner, corner_end});
+				object_sizes.back() += corner_end - corner;
+			}
+
+			if (o < chunk.objects.size()) {
+				file.objects.push_back(Object{std::move(chunk.objects[o].name), {}, {}});
+				object_segments.emplace_back();
+				object_sizes.push_back(0);
+			}
+			corner = corner_end;
+		}
+	}
+
+	///////////////////
+	// Resolve Faces //
+	///////////////////
+
+	// Each object is deduplicated on its own, so objects resolve in parallel.
+	std::vector<const char*> resolve_errors(file.objects.size(), nullptr);
+
+	auto resolve = [&](std::size_t i) {
+		for (std::size_t o = i; o < file.objects.size(); o += threads) {
+			auto& obj = file.objects[o];
+
+			Corner_Map map(object_sizes[o]);
+			obj.indices.reserve(object_sizes[o]);
+
+			for (auto& seg : object_segments[o]) {
+				auto& chunk = chunks[seg.chunk];
+
+				for (std::size_t c = seg.corner_begin; c < seg.corner_end; ++c) {
+					const Corner& corner = chunk.corners[c];
+
+					if (corner.v > vertices.size() || corner.vt > texcoords.size() || corner.vn > normals.size()) {
+						resolve_errors[o] = "Face index out of range";
+						return;
 					}
-					// skip /
-					fs.ignore();
-
-					vtfail = !(fs >> vtindex);
-					fs.clear();
-					fs.ignore();
-
-					vnfail = !(fs >> vnindex);
-					fs.clear();
-
-					// Push a vertex
-					file.objects.back().vertices.push_back(Vertex{
-					    std::get<0>(vertices[vindex - 1]),                // x
-					    std::get<1>(vertices[vindex - 1]),                // y
-					    std::get<2>(vertices[vindex - 1]),                // z
-					    vtfail ? 0 : std::get<0>(texcoords[vtindex - 1]), // texcoord x
-					    vtfail ? 0 : std::get<1>(texcoords[vtindex - 1]), // texcoord y
-					    vnfail ? 0 : std::get<0>(normals[vnindex - 1]),   // normal x
-					    vnfail ? 0 : std::get<1>(normals[vnindex - 1]),   // normal y
-					    vnfail ? 0 : std::get<2>(normals[vnindex - 1])    // normal z
+
+					auto index = static_cast<std::uint32_t>(obj.vertices.size());
+					if (!map.insert(corner, index)) {
+						obj.indices.push_back(index);
+						continue;
+					}
+
+					const Position& pos = vertices[corner.v - 1];
+					Texcoord tex        = corner.vt ? texcoords[corner.vt - 1] : Texcoord{0, 0};
+					Position norm       = corner.vn ? normals[corner.vn - 1] : Position{0, 0, 0};
+
+					obj.vertices.push_back(Vertex{
+					    pos.x,  // x
+					    pos.y,  // y
+					    pos.z,  // z
+					    tex.x,  // texcoord x
+					    tex.y,  // texcoord y
+					    norm.x, // normal x
+					    norm.y, // normal y
+					    norm.z  // normal z
 					});
+					obj.indices.push_back(index);
 				}
-				break;
 			}
 		}
+	};
 
-		std::string _;
-		std::getline(fs, _);
-		line++;
-	}
+	threads = std::min(threads, file.objects.size());
+	run_parallel(threads, resolve);
 
-#undef error
+	for (auto err : resolve_errors) {
+		if (err) {
+			std::cerr << name << ": .obj parsing failed: " << err << '\n';
+			throw std::runtime_error(err);
+		}
+	}
 
 	return file;
 }
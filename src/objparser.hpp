@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <utility>
 #include <vector>
@@ -17,11 +19,13 @@ struct Vertex {
 
 struct Object {
 	std::string name;
-	std::vector<Vertex> vertices;
+	std::vector<Vertex> vertices;       // Unique (v, vt, vn) combinations
+	std::vector<std::uint32_t> indices; // Three per triangle
 };
 
 struct ObjFile {
 	std::vector<Object> objects;
 };
 
-ObjFile parse_obj_file(std::string name);
+// Memory maps the file and parses it on up to `threads` threads (0 = one per core).
+ObjFile parse_obj_file(std::string name, std::size_t threads = 0);
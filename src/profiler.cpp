@@ -0,0 +1,190 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+	struct Summary {
+		double min, avg, p99;
+	};
+
+	Summary summarize(std::vector<double> samples) {
+		if (samples.empty()) {
+			return Summary{0, 0, 0};
+		}
+		Summary s;
+		s.min = *std::min_element(samples.begin(), samples.end());
+		s.avg = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+		auto p99 = samples.begin() + (samples.size() * 99 + 99) / 100 - 1;
+		std::nth_element(samples.begin(), p99, samples.end());
+		s.p99 = *p99;
+		return s;
+	}
+
+	void add_sample(std::vector<double>& ring, std::size_t next, double value) {
+		if (ring.size() < Profiler::window) {
+			ring.push_back(value);
+		}
+		else {
+			ring[next] = value;
+		}
+	}
+} // namespace
+
+constexpr std::size_t Profiler::frames_in_flight;
+constexpr std::size_t Profiler::window;
+constexpr std::size_t Profiler::trace_frames;
+
+Profiler::Profiler() : epoch(Clock::now()) {}
+
+Profiler::~Profiler() {
+	for (auto& frame : frames) {
+		if (!frame.queries.empty()) {
+			glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+		}
+	}
+}
+
+void Profiler::begin(const char* name) {
+	Frame& frame = frames[frame_number % frames_in_flight];
+	if (in_pass) {
+		std::cerr << "Pass " << name << " began inside " << frame.records.back().name << '\n';
+		throw std::runtime_error("Overlapping profiler passes");
+	}
+
+	std::size_t index = frame.records.size();
+	if (index == frame.queries.size()) {
+		GLuint query;
+		glGenQueries(1, &query);
+		frame.queries.push_back(query);
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, frame.queries[index]);
+	frame.records.push_back(Record{name, Clock::now(), 0});
+	in_pass = true;
+}
+
+void Profiler::end() {
+	glEndQuery(GL_TIME_ELAPSED);
+	Record& record = frames[frame_number % frames_in_flight].records.back();
+	record.cpu_ms  = std::chrono::duration<double, std::milli>(Clock::now() - record.start).count();
+	in_pass        = false;
+}
+
+void Profiler::end_frame(bool wait) {
+	Frame& current  = frames[frame_number % frames_in_flight];
+	current.number  = frame_number;
+	current.pending = true;
+	++frame_number;
+
+	// Oldest first. Queries finish in order, so once one frame isn't done the later ones aren't either.
+	for (std::size_t i = 0; i < frames_in_flight; ++i) {
+		Frame& frame = frames[(frame_number + i) % frames_in_flight];
+		if (!frame.pending) {
+			continue;
+		}
+		if (!wait && !available(frame)) {
+			break;
+		}
+		collect(frame);
+	}
+
+	// The GPU is a whole ring behind, the next frame's queries have to be read before they're reused
+	Frame& next = frames[frame_number % frames_in_flight];
+	if (next.pending) {
+		collect(next);
+	}
+}
+
+bool Profiler::available(const Frame& frame) const {
+	if (frame.records.empty()) {
+		return true;
+	}
+	GLint done = 0;
+	glGetQueryObjectiv(frame.queries[frame.records.size() - 1], GL_QUERY_RESULT_AVAILABLE, &done);
+	return done != 0;
+}
+
+void Profiler::collect(Frame& frame) {
+	passes.clear();
+	for (std::size_t i = 0; i < frame.records.size(); ++i) {
+		const Record& record = frame.records[i];
+
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &ns);
+		double gpu_ms = ns / 1e6;
+
+		passes.push_back(Pass{record.name, record.cpu_ms, gpu_ms});
+
+		Stats& s = stats_for(record.name);
+		add_sample(s.cpu_ms, s.next, record.cpu_ms);
+		add_sample(s.gpu_ms, s.next, gpu_ms);
+		s.next = (s.next + 1) % window;
+
+		double start_us = std::chrono::duration<double, std::micro>(record.start - epoch).count();
+		trace.push_back(Trace_Event{record.name, frame.number, start_us, record.cpu_ms * 1000, gpu_ms * 1000});
+	}
+	passes_frame = frame.number;
+
+	while (!trace.empty() && trace.front().frame + trace_frames <= frame.number) {
+		trace.pop_front();
+	}
+
+	frame.records.clear();
+	frame.pending = false;
+}
+
+Profiler::Stats& Profiler::stats_for(const char* name) {
+	auto it = std::find_if(stats.begin(), stats.end(), [&](const Stats& s) { return s.name == name; });
+	if (it != stats.end()) {
+		return *it;
+	}
+	stats.push_back(Stats{name, {}, {}, 0});
+	return stats.back();
+}
+
+void Profiler::print(std::ostream& out) const {
+	auto flags     = out.flags();
+	auto precision = out.precision();
+
+	out << std::left << std::setw(12) << "Pass" << std::setw(26) << "CPU min/avg/p99 ms"
+	    << "GPU min/avg/p99 ms\n";
+	out << std::fixed << std::setprecision(3);
+	for (auto& s : stats) {
+		Summary cpu = summarize(s.cpu_ms);
+		Summary gpu = summarize(s.gpu_ms);
+		out << std::setw(12) << s.name << std::right << std::setw(7) << cpu.min << std::setw(8) << cpu.avg << std::setw(8)
+		    << cpu.p99 << "   " << std::setw(7) << gpu.min << std::setw(8) << gpu.avg << std::setw(8) << gpu.p99 << '\n'
+		    << std::left;
+	}
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+void Profiler::write_trace(const std::string& path) const {
+	std::ofstream out(path);
+	if (!out) {
+		std::cerr << "Can't open " << path << " for writing\n";
+		throw std::runtime_error("Trace output failed");
+	}
+
+	// GPU passes are placed where the CPU issued them, only their length is measured
+	out << "{\"traceEvents\":[\n"
+	    << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n"
+	    << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"GPU\"}}";
+	out << std::fixed << std::setprecision(3);
+	for (auto& e : trace) {
+		out << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":" << e.start_us
+		    << ",\"dur\":" << e.cpu_us << ",\"args\":{\"frame\":" << e.frame << "}}";
+		out << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":1,\"ts\":" << e.start_us
+		    << ",\"dur\":" << e.gpu_us << ",\"args\":{\"frame\":" << e.frame << "}}";
+	}
+	out << "\n]}\n";
+
+	std::cerr << "Wrote " << trace.size() << " passes to " << path << '\n';
+}
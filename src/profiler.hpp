@@ -0,0 +1,117 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// CPU and GPU time of each named pass in a frame.
+//
+// GPU times come from GL_TIME_ELAPSED queries. Those can't nest, so passes
+// mustn't overlap. Each frame's queries are read frames_in_flight - 1 frames
+// later, once the GPU has caught up, so measuring doesn't stall the pipeline.
+// Every pass keeps a rolling window of samples for print(), and the last
+// trace_frames frames can be written out as a Chrome trace.
+class Profiler {
+  public:
+	static constexpr std::size_t frames_in_flight = 3;
+	static constexpr std::size_t window           = 240;
+	static constexpr std::size_t trace_frames     = 600;
+
+	struct Pass {
+		std::string name;
+		double cpu_ms;
+		double gpu_ms;
+	};
+
+	// Times its enclosing block as one pass.
+	class Scope {
+	  public:
+		Scope(Profiler& profiler, const char* name) : profiler(profiler) {
+			profiler.begin(name);
+		}
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+		~Scope() {
+			profiler.end();
+		}
+
+	  private:
+		Profiler& profiler;
+	};
+
+	Profiler();
+	Profiler(const Profiler&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+	~Profiler();
+
+	// name must outlive the frame, string literals are fine.
+	void begin(const char* name);
+	void end();
+
+	// Starts the next frame and collects every finished one. With wait it
+	// blocks until this frame's results are in, for exact per frame numbers.
+	void end_frame(bool wait = false);
+
+	// The passes of the newest collected frame, in the order they began.
+	const std::vector<Pass>& get_passes() const {
+		return passes;
+	}
+	std::uint64_t get_passes_frame() const {
+		return passes_frame;
+	}
+
+	// Min, average and 99th percentile of every pass over the window.
+	void print(std::ostream& out) const;
+	// Chrome trace event JSON, for chrome://tracing or Perfetto.
+	void write_trace(const std::string& path) const;
+
+  private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Record {
+		const char* name;
+		Clock::time_point start;
+		double cpu_ms;
+	};
+
+	struct Frame {
+		std::uint64_t number = 0;
+		bool pending         = false;
+		std::vector<Record> records;
+		std::vector<GLuint> queries;
+	};
+
+	struct Stats {
+		std::string name;
+		std::vector<double> cpu_ms, gpu_ms; // Rings of window samples
+		std::size_t next = 0;
+	};
+
+	struct Trace_Event {
+		const char* name;
+		std::uint64_t frame;
+		double start_us;
+		double cpu_us, gpu_us;
+	};
+
+	bool available(const Frame& frame) const;
+	void collect(Frame& frame);
+	Stats& stats_for(const char* name);
+
+	Frame frames[frames_in_flight];
+	std::uint64_t frame_number = 0;
+	bool in_pass               = false;
+
+	std::vector<Pass> passes;
+	std::uint64_t passes_frame = 0;
+
+	std::vector<Stats> stats;
+	std::deque<Trace_Event> trace;
+	Clock::time_point epoch;
+};
@@ -0,0 +1,84 @@
+#include "readbackbuffer.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+constexpr std::size_t Readback_Buffer::frames_in_flight;
+
+Readback_Buffer::Readback_Buffer(std::size_t size) : size(size) {
+	glGenBuffers(frames_in_flight, buffers);
+	for (auto buffer : buffers) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+Readback_Buffer::~Readback_Buffer() {
+	for (auto& fence : fences) {
+		if (fence) {
+			glDeleteSync(fence);
+		}
+	}
+	glDeleteBuffers(frames_in_flight, buffers);
+}
+
+void Readback_Buffer::get_tex_image(GLenum target, GLint level, GLenum format, GLenum type) {
+	// A copy still unread after a whole ring is dropped rather than waited for.
+	// The GPU writes the buffer in order, so reusing it needs no sync.
+	if (fences[slot]) {
+		glDeleteSync(fences[slot]);
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[slot]);
+	glGetTexImage(target, level, format, type, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	fences[slot]   = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	sequence[slot] = next_sequence++;
+	slot           = (slot + 1) % frames_in_flight;
+}
+
+bool Readback_Buffer::latest(void* out) {
+	std::size_t newest = frames_in_flight;
+	for (std::size_t i = 0; i < frames_in_flight; ++i) {
+		if (!fences[i]) {
+			continue;
+		}
+		GLenum result = glClientWaitSync(fences[i], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		if (result == GL_WAIT_FAILED) {
+			std::cerr << "Readback buffer fence wait failed\n";
+			throw std::runtime_error("Readback buffer fence wait failed");
+		}
+		if (result == GL_TIMEOUT_EXPIRED) {
+			continue;
+		}
+		if (newest == frames_in_flight || sequence[i] > sequence[newest]) {
+			newest = i;
+		}
+	}
+
+	if (newest == frames_in_flight) {
+		return false;
+	}
+
+	// Copies older than the newest one are finished too and no longer wanted
+	for (std::size_t i = 0; i < frames_in_flight; ++i) {
+		if (fences[i] && sequence[i] <= sequence[newest]) {
+			glDeleteSync(fences[i]);
+			fences[i] = nullptr;
+		}
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[newest]);
+	void* ptr = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+	if (!ptr) {
+		std::cerr << "Readback buffer map failed\n";
+		throw std::runtime_error("Readback buffer map failed");
+	}
+	std::memcpy(out, ptr, size);
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	return true;
+}
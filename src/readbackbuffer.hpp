@@ -0,0 +1,35 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Ring of pixel pack buffers for reading small GPU results back without stalling.
+//
+// get_tex_image() queues a copy into this frame's buffer and fences it.
+// latest() hands back the newest copy the GPU has finished, usually from
+// frames_in_flight - 1 frames ago, and never waits on one still in flight.
+class Readback_Buffer {
+  public:
+	static constexpr std::size_t frames_in_flight = 3;
+
+	explicit Readback_Buffer(std::size_t size);
+	Readback_Buffer(const Readback_Buffer&) = delete;
+	Readback_Buffer& operator=(const Readback_Buffer&) = delete;
+	~Readback_Buffer();
+
+	// glGetTexImage of the texture bound to target, which must fit in size bytes.
+	void get_tex_image(GLenum target, GLint level, GLenum format, GLenum type);
+
+	// Copies the newest finished copy into out, or returns false if none finished since the last call.
+	bool latest(void* out);
+
+  private:
+	std::size_t size;
+	GLuint buffers[frames_in_flight] = {};
+	GLsync fences[frames_in_flight]  = {};
+	std::uint64_t sequence[frames_in_flight] = {}; // Order the copies were queued in
+	std::uint64_t next_sequence = 0;
+	std::size_t slot            = 0;
+};
@@ -1 +1,85 @@
 #include "renderer.hpp"
+#include "glstate.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+constexpr GLuint Renderer::no_framebuffer;
+
+Renderer::Resource Renderer::resource(const std::string& name) {
+	auto it = std::find(names.begin(), names.end(), name);
+	if (it != names.end()) {
+		return static_cast<Resource>(it - names.begin());
+	}
+	names.push_back(name);
+	outputs.push_back(false);
+	return names.size() - 1;
+}
+
+void Renderer::output(Resource resource) {
+	outputs[resource] = true;
+}
+
+void Renderer::add_pass(const char* name, GLuint framebuffer, std::vector<Resource> reads,
+                        std::vector<Resource> writes, std::function<void()> run) {
+	passes.push_back(Pass{name, framebuffer, std::move(reads), std::move(writes), std::move(run), false});
+	culled_passes = false;
+}
+
+void Renderer::clear() {
+	passes.clear();
+	culled_passes = false;
+}
+
+void Renderer::cull() {
+	// Backwards from the outputs: a pass is needed if a later needed pass, or the frame itself, reads what it writes
+	std::vector<bool> needed = outputs;
+	for (auto pass = passes.rbegin(); pass != passes.rend(); ++pass) {
+		pass->culled = std::none_of(pass->writes.begin(), pass->writes.end(), [&](Resource r) { return needed[r]; });
+		if (!pass->culled) {
+			for (Resource r : pass->reads) {
+				needed[r] = true;
+			}
+		}
+	}
+
+	executed.clear();
+	culled.clear();
+	for (auto& pass : passes) {
+		(pass.culled ? culled : executed).push_back(pass.name);
+	}
+	culled_passes = true;
+}
+
+void Renderer::execute(Profiler& profiler) {
+	if (!culled_passes) {
+		cull();
+	}
+
+	for (auto& pass : passes) {
+		if (pass.culled) {
+			continue;
+		}
+
+		Profiler::Scope scope(profiler, pass.name);
+		if (pass.framebuffer != no_framebuffer) {
+			gl.bind_framebuffer(pass.framebuffer);
+		}
+		pass.run();
+	}
+}
+
+void Renderer::print(std::ostream& out) const {
+	out << "Passes:";
+	for (auto name : executed) {
+		out << ' ' << name;
+	}
+	if (!culled.empty()) {
+		out << " - culled:";
+		for (auto name : culled) {
+			out << ' ' << name;
+		}
+	}
+	out << '\n';
+}
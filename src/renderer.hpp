@@ -2,18 +2,75 @@
 
 #include <GL/glew.h>
 
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class GL_State;
+class Profiler;
+
+// Frame graph for the render loop.
+//
+// Passes are added in order, each naming the resources it reads and writes
+// and the framebuffer it draws into. The graph is kept and executed every
+// frame until clear(), which the caller does when the settings that decide
+// which passes run change or the framebuffers are remade. The first
+// execute() after a build walks back from the outputs and culls every pass
+// whose writes nobody reads. Each pass that runs is timed as its own
+// profiler pass. Framebuffers are bound through the GL_State, so
+// consecutive passes drawing into the same target don't switch.
 class Renderer {
-private:
-	GLuint gBuffer;
-	GLuint gPosition, gNormal, gAlbedoSpec, gDepth;
+  public:
+	using Resource = std::size_t;
+
+	// For passes that don't draw, like compute or CPU work
+	static constexpr GLuint no_framebuffer = ~GLuint(0);
+
+	explicit Renderer(GL_State& gl) : gl(gl) {}
+	Renderer(const Renderer&) = delete;
+	Renderer& operator=(const Renderer&) = delete;
+
+	// Names are looked up once, the handles stay valid for the Renderer's life.
+	Resource resource(const std::string& name);
+	// Outputs are what the frame is for, their writers are never culled.
+	void output(Resource resource);
+
+	// name must outlive the graph, string literals are fine. run is called every
+	// frame, so anything it captures by reference has to outlive the graph too.
+	void add_pass(const char* name, GLuint framebuffer, std::vector<Resource> reads,
+	              std::vector<Resource> writes, std::function<void()> run);
+	// Forgets every pass, the next frame builds the graph again.
+	void clear();
+	bool empty() const {
+		return passes.empty();
+	}
+
+	// Culls if the graph changed, then runs the passes left.
+	void execute(Profiler& profiler);
+
+	// The passes that run and what was culled.
+	void print(std::ostream& out) const;
+
+  private:
+	struct Pass {
+		const char* name;
+		GLuint framebuffer;
+		std::vector<Resource> reads, writes;
+		std::function<void()> run;
+		bool culled;
+	};
+
+	void cull();
 
-	void DeletegBuffer();
+	std::vector<std::string> names;
+	std::vector<bool> outputs;
+	std::vector<Pass> passes;
+	bool culled_passes = false; // cull() has run since the last change
 
-public:
-	void Init();
-	void CreategBuffer();
-	void Resize();
+	// For print()
+	std::vector<const char*> executed, culled;
 
-	void useGeometryPass();
-	void useLightingPass();
+	GL_State& gl;
 };
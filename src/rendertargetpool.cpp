@@ -0,0 +1,140 @@
+#include "rendertargetpool.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+	struct Format_Info {
+		GLenum internal_format;
+		GLenum format, type; // Any compatible pair, nothing is uploaded
+		std::size_t bytes;   // Per pixel as drivers store it
+	};
+
+	// Three component formats are padded to four and 32F + 8 depth-stencil to 64 bits
+	constexpr Format_Info formats[] = {
+	    {GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1},
+	    {GL_R16F, GL_RED, GL_FLOAT, 2},
+	    {GL_RG16, GL_RG, GL_UNSIGNED_SHORT, 4},
+	    {GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4},
+	    {GL_RGB16F, GL_RGB, GL_FLOAT, 8},
+	    {GL_RGBA16F, GL_RGBA, GL_FLOAT, 8},
+	    {GL_RGBA32F, GL_RGBA, GL_FLOAT, 16},
+	    {GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, 4},
+	    {GL_DEPTH32F_STENCIL8, GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV, 8},
+	};
+
+	const Format_Info& format_info(GLenum internal_format) {
+		auto it = std::find_if(std::begin(formats), std::end(formats),
+		                       [&](const Format_Info& f) { return f.internal_format == internal_format; });
+		if (it == std::end(formats)) {
+			std::cerr << "Render target pool doesn't know internal format 0x" << std::hex << internal_format << std::dec << '\n';
+			throw std::runtime_error("Unknown render target format");
+		}
+		return *it;
+	}
+} // namespace
+
+constexpr std::size_t Render_Target_Pool::max_idle_frames;
+
+Render_Target_Pool::~Render_Target_Pool() {
+	for (auto& target : targets) {
+		glDeleteTextures(1, &target.texture);
+	}
+}
+
+GLuint Render_Target_Pool::acquire(GLenum internal_format, std::size_t width, std::size_t height) {
+	for (auto& target : targets) {
+		if (!target.in_use && target.internal_format == internal_format && target.width == width && target.height == height) {
+			target.in_use = true;
+			return target.texture;
+		}
+	}
+
+	const Format_Info& info = format_info(internal_format);
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internal_format, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, info.format,
+	             info.type, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	targets.push_back(Target{texture, internal_format, width, height, width * height * info.bytes, true, 0});
+	allocations += 1;
+	return texture;
+}
+
+void Render_Target_Pool::release(GLuint texture) {
+	if (texture == 0) {
+		return;
+	}
+
+	auto it = std::find_if(targets.begin(), targets.end(), [&](const Target& t) { return t.texture == texture; });
+	if (it == targets.end() || !it->in_use) {
+		std::cerr << "Texture " << texture << " released to a render target pool it wasn't acquired from\n";
+		throw std::runtime_error("Bad render target release");
+	}
+	it->in_use         = false;
+	it->released_frame = frame_number;
+}
+
+void Render_Target_Pool::delete_other_sizes() {
+	std::vector<std::pair<std::size_t, std::size_t>> sizes;
+	for (auto& target : targets) {
+		if (target.in_use) {
+			sizes.emplace_back(target.width, target.height);
+		}
+	}
+
+	auto stale = std::remove_if(targets.begin(), targets.end(), [&](const Target& t) {
+		if (t.in_use || std::find(sizes.begin(), sizes.end(), std::make_pair(t.width, t.height)) != sizes.end()) {
+			return false;
+		}
+		glDeleteTextures(1, &t.texture);
+		return true;
+	});
+	targets.erase(stale, targets.end());
+}
+
+void Render_Target_Pool::end_frame() {
+	frame_number += 1;
+
+	auto idle = std::remove_if(targets.begin(), targets.end(), [&](const Target& t) {
+		if (t.in_use || frame_number - t.released_frame <= max_idle_frames) {
+			return false;
+		}
+		glDeleteTextures(1, &t.texture);
+		return true;
+	});
+	targets.erase(idle, targets.end());
+}
+
+Render_Target_Pool::Usage Render_Target_Pool::get_usage() const {
+	Usage usage{targets.size(), 0, 0, allocations};
+	for (auto& target : targets) {
+		usage.bytes += target.bytes;
+		if (target.in_use) {
+			usage.bytes_in_use += target.bytes;
+		}
+	}
+	return usage;
+}
+
+void Render_Target_Pool::print(std::ostream& out) const {
+	Usage usage = get_usage();
+
+	auto flags     = out.flags();
+	auto precision = out.precision();
+
+	out << std::fixed << std::setprecision(1) << "Render targets: " << usage.textures << " textures, " << usage.bytes / 1e6
+	    << " MB (" << usage.bytes_in_use / 1e6 << " MB in use), " << usage.allocations << " allocations\n";
+
+	out.flags(flags);
+	out.precision(precision);
+}
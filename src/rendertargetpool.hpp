@@ -0,0 +1,61 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+// Screen sized textures, recycled by internal format and size.
+//
+// release() hands a texture back instead of deleting it, and the next
+// acquire() of the same format and size gets it again, so toggling render
+// settings back and forth doesn't reallocate. Textures nobody asks for within
+// max_idle_frames are deleted. A resize changes every size at once, so
+// delete_other_sizes() drops the old ones right away rather than letting a
+// window drag keep a set alive for each of the last few sizes it passed.
+// Everything comes out nearest filtered and clamped to edge.
+class Render_Target_Pool {
+  public:
+	static constexpr std::size_t max_idle_frames = 8;
+
+	struct Usage {
+		std::size_t textures;
+		std::size_t bytes;        // Level 0 only, mipmaps made later aren't counted
+		std::size_t bytes_in_use;
+		std::uint64_t allocations; // Since the pool was made
+	};
+
+	Render_Target_Pool() = default;
+	Render_Target_Pool(const Render_Target_Pool&) = delete;
+	Render_Target_Pool& operator=(const Render_Target_Pool&) = delete;
+	~Render_Target_Pool();
+
+	// Contents are undefined, a reused texture keeps whatever it held.
+	GLuint acquire(GLenum internal_format, std::size_t width, std::size_t height);
+	// Releasing 0 does nothing.
+	void release(GLuint texture);
+
+	// Deletes released textures of a size no acquired texture has, for after a resize.
+	void delete_other_sizes();
+	// Deletes textures idle for more than max_idle_frames.
+	void end_frame();
+
+	Usage get_usage() const;
+	void print(std::ostream& out) const;
+
+  private:
+	struct Target {
+		GLuint texture;
+		GLenum internal_format;
+		std::size_t width, height;
+		std::size_t bytes;
+		bool in_use;
+		std::uint64_t released_frame;
+	};
+
+	std::vector<Target> targets;
+	std::uint64_t frame_number = 0;
+	std::uint64_t allocations  = 0;
+};
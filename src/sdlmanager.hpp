@@ -6,18 +6,39 @@
 #include <GL/glew.h>
 #include <SDL2/SDL.h>
 
+#ifndef _WIN32
+// Keep Xlib's macros out, headless runs never touch X
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 
 struct SDL_Manager {
-	SDL_Window* mainWindow;
-	SDL_GLContext mainContext;
+	SDL_Window* mainWindow = nullptr;
+	SDL_GLContext mainContext = nullptr;
 	struct size_t {
 		int width;
 		int height;
 		float ratio;
 	} size;
-	SDL_Manager() {
+
+	// Headless runs have no window or default framebuffer, everything that
+	// would go to the screen goes to this offscreen framebuffer instead.
+	bool headless = false;
+	GLuint framebuffer = 0;
+	GLuint framebufferColor = 0, framebufferDepth = 0;
+
+	explicit SDL_Manager(bool headless = false) : headless(headless) {
+		if (headless) {
+			create_headless_context();
+			return;
+		}
+
 		if (SDL_Init(SDL_INIT_VIDEO) < 0) {
 			std::ostringstream ss;
 			ss << "Video initialization failed: " << SDL_GetError() << '\n';
@@ -35,14 +56,26 @@ struct SDL_Manager {
 		}
 
 		SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
 		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
 		#ifdef DLDEBUG
 		SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
 		#endif
 		SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
 
+		// 4.3 for compute shaders, everything else only needs 3.3
 		mainContext = SDL_GL_CreateContext(mainWindow);
+		if (!mainContext) {
+			SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+			SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+			mainContext = SDL_GL_CreateContext(mainWindow);
+		}
+
+		if (!mainContext) {
+			std::ostringstream ss;
+			ss << "OpenGL context creation failed: " << SDL_GetError() << '\n';
+			throw std::runtime_error(ss.str().c_str());
+		}
 
 		SDL_GL_SetSwapInterval(0);
 
@@ -52,13 +85,110 @@ struct SDL_Manager {
 		this->refresh_size();
 	}
 	~SDL_Manager() {
+		if (headless) {
+			glDeleteFramebuffers(1, &framebuffer);
+			glDeleteRenderbuffers(1, &framebufferColor);
+			glDeleteRenderbuffers(1, &framebufferDepth);
+			#ifndef _WIN32
+			eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			eglDestroyContext(eglDisplay, eglContext);
+			eglTerminate(eglDisplay);
+			#endif
+			return;
+		}
+
 		SDL_GL_DeleteContext(mainContext);
 		SDL_DestroyWindow(mainWindow);
 		SDL_Quit();
 	}
 	void refresh_size() {
-		SDL_GetWindowSize(mainWindow, &(this->size.width), &(this->size.height));
+		if (!headless) {
+			SDL_GetWindowSize(mainWindow, &(this->size.width), &(this->size.height));
+		}
 		glViewport(0, 0, size.width, size.height);
 		size.ratio = (float) size.width / (float) size.height;
 	}
-};
\ No newline at end of file
+	// The framebuffer standing in for the screen
+	GLuint output_framebuffer() const {
+		return framebuffer;
+	}
+	void swap() {
+		if (!headless) {
+			SDL_GL_SwapWindow(mainWindow);
+		}
+	}
+
+  private:
+	#ifndef _WIN32
+	EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+	EGLContext eglContext = EGL_NO_CONTEXT;
+	#endif
+
+	void create_headless_context() {
+		#ifdef _WIN32
+		std::cerr << "Headless mode needs EGL, which Windows builds don't have\n";
+		throw std::runtime_error("Headless mode unsupported");
+		#else
+		// Mesa's surfaceless platform needs no display server at all, so this runs on llvmpipe
+		auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (get_platform_display) {
+			eglDisplay = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		}
+		if (eglDisplay == EGL_NO_DISPLAY) {
+			eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		}
+		if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, nullptr, nullptr)) {
+			std::cerr << "EGL initialization failed\n";
+			throw std::runtime_error("EGL initialization failed");
+		}
+		eglBindAPI(EGL_OPENGL_API);
+
+		EGLConfig config = nullptr;
+		EGLint config_count = 0;
+		constexpr EGLint config_attribs[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+		eglChooseConfig(eglDisplay, config_attribs, &config, 1, &config_count);
+
+		// Same versions as the windowed context
+		constexpr EGLint versions[][2] = {{4, 3}, {3, 3}};
+		for (auto& version : versions) {
+			const EGLint context_attribs[] = {
+				EGL_CONTEXT_MAJOR_VERSION, version[0],
+				EGL_CONTEXT_MINOR_VERSION, version[1],
+				EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+				EGL_NONE
+			};
+			eglContext = eglCreateContext(eglDisplay, config_count ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, context_attribs);
+			if (eglContext != EGL_NO_CONTEXT) {
+				break;
+			}
+		}
+
+		if (eglContext == EGL_NO_CONTEXT || !eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext)) {
+			std::cerr << "EGL context creation failed\n";
+			throw std::runtime_error("EGL context creation failed");
+		}
+
+		// GLEW built for GLX reports GLEW_ERROR_NO_GLX_DISPLAY here, but only after loading every GL entry point
+		glewExperimental = GL_TRUE;
+		glewInit();
+
+		size.width = WINDOW_WIDTH;
+		size.height = WINDOW_HEIGHT;
+
+		glGenRenderbuffers(1, &framebufferColor);
+		glBindRenderbuffer(GL_RENDERBUFFER, framebufferColor);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size.width, size.height);
+		glGenRenderbuffers(1, &framebufferDepth);
+		glBindRenderbuffer(GL_RENDERBUFFER, framebufferDepth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, size.width, size.height);
+
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, framebufferColor);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, framebufferDepth);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		this->refresh_size();
+		#endif
+	}
+};
@@ -1,5 +1,6 @@
 #include <GL/glew.h>
 
+#include "glstate.hpp"
 #include "shader.hpp"
 #include "util.hpp"
 
@@ -7,6 +8,44 @@
 #include <iostream>
 #include <sstream>
 
+namespace {
+	// Pastes in #include "file" lines. #line keeps error line numbers
+	// pointing into the including file.
+	std::string expand_includes(const std::string& filename, std::size_t depth = 0) {
+		if (depth > 16) {
+			std::cerr << "Shader includes nested too deep at " << filename << '\n';
+			throw std::runtime_error("Shader include failed.");
+		}
+
+		std::string code = file_contents(filename.c_str());
+		if (code.empty()) {
+			throw std::runtime_error("Shader include failed.");
+		}
+		std::string directory = filename.substr(0, filename.find_last_of('/') + 1);
+
+		std::istringstream in(code);
+		std::string line, result;
+		for (std::size_t number = 1; std::getline(in, line); ++number) {
+			auto start = line.find_first_not_of(" \t");
+			if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+				result += line + '\n';
+				continue;
+			}
+
+			auto open = line.find('"', start);
+			auto close = open == std::string::npos ? open : line.find('"', open + 1);
+			if (close == std::string::npos) {
+				std::cerr << filename << ':' << number << ": malformed include: " << line << '\n';
+				throw std::runtime_error("Shader include failed.");
+			}
+			result += "#line 1\n";
+			result += expand_includes(directory + line.substr(open + 1, close - open - 1), depth + 1);
+			result += "#line " + std::to_string(number + 1) + '\n';
+		}
+		return result;
+	}
+} // namespace
+
 Shader_Program::Shader_Program() {
 	this->program = glCreateProgram();
 }
@@ -37,8 +76,17 @@ void Shader_Program::add(const char* filename, Shader::shadertype_t type) {
 	this->add(filename, new_type);
 }
 
+void Shader_Program::define(const char* name, const char* value) {
+	defines += std::string("#define ") + name + ' ' + value + '\n';
+}
+
 void Shader_Program::add(const char* filename, GLenum type) {
-	std::string code = file_contents(filename);
+	std::string code = expand_includes(filename);
+	if (!defines.empty()) {
+		// #version has to stay first
+		std::size_t after_version = code.compare(0, 8, "#version") == 0 ? code.find('\n') + 1 : 0;
+		code.insert(after_version, defines + "#line " + (after_version ? "2" : "1") + '\n');
+	}
 	const char* code_ptr = code.c_str();
 
 	GLuint ident;
@@ -89,6 +137,10 @@ void Shader_Program::use() {
 	glUseProgram(this->program);
 }
 
+void Shader_Program::use(GL_State& gl) {
+	gl.use_program(this->program);
+}
+
 GLuint Shader_Program::getUniform(const char* uniform_name, Shader::throwonfail_t should_throw) {
 	GLint name = glGetUniformLocation(program, uniform_name);
 	if (name == -1 && should_throw) {
@@ -100,3 +152,18 @@ GLuint Shader_Program::getUniform(const char* uniform_name, Shader::throwonfail_
 
 	return name;
 }
+
+void Shader_Program::bindUniformBlock(const char* block_name, GLuint binding, Shader::throwonfail_t should_throw) {
+	GLuint index = glGetUniformBlockIndex(program, block_name);
+	if (index == GL_INVALID_INDEX) {
+		if (should_throw) {
+			std::ostringstream err_str;
+			err_str << "Can't find uniform block named " << block_name << ".\n";
+			std::cerr << err_str.str() << '\n';
+			throw std::runtime_error(err_str.str().c_str());
+		}
+		return;
+	}
+
+	glUniformBlockBinding(program, index, binding);
+}
@@ -1,8 +1,11 @@
 #pragma once
 
 #include <GL/gl.h>
+#include <string>
 #include <vector>
 
+class GL_State;
+
 namespace Shader {
 	enum shadertype_t { VERTEX, GEOMETRY, TESS_C, TESS_E, FRAGMENT, COMPUTE };
 	enum throwonfail_t { MANDITORY = 1, OPTIONAL = 0};
@@ -12,13 +15,20 @@ class Shader_Program {
   public:
 	Shader_Program();
 
+	// Sources may #include "file" relative to themselves, and get every
+	// define() made before they're added inserted after their #version.
+	void define(const char* name, const char* value = "");
 	void add(const char* filename, GLenum type);
 	void add(const char* filename, Shader::shadertype_t type);
 	void compile();
 	void link();
 	void use();
+	// Skips glUseProgram if it's already in use.
+	void use(GL_State& gl);
 
 	GLuint getUniform(const char* uniform_name, Shader::throwonfail_t = Shader::OPTIONAL);
+	// Points a uniform block at a buffer binding point. Call after link().
+	void bindUniformBlock(const char* block_name, GLuint binding, Shader::throwonfail_t = Shader::OPTIONAL);
 	GLuint getProgram() {
 		return program;
 	}
@@ -26,6 +36,7 @@ class Shader_Program {
   private:
 	std::vector<GLuint> shaders;
 	GLuint program;
+	std::string defines;
 
 	void print_compile_errors(GLuint ident);
 	void print_linker_errors(GLuint ident);
@@ -0,0 +1,126 @@
+#include "streambuffer.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+constexpr std::size_t Stream_Buffer::frames_in_flight;
+constexpr std::size_t Stream_Buffer::alignment;
+
+Stream_Buffer::Stream_Buffer(GLenum target) : target(target), persistent(GLEW_ARB_buffer_storage) {}
+
+Stream_Buffer::~Stream_Buffer() {
+	release();
+}
+
+void* Stream_Buffer::map(std::size_t size) {
+	if (size == 0) {
+		return nullptr;
+	}
+
+	if (size > region_size) {
+		// Double so a slowly growing light count doesn't recreate the buffer every frame
+		allocate(std::max(size, region_size * 2));
+	}
+
+	wait(region);
+	glBindBuffer(target, buffer);
+
+	if (persistent) {
+		return persistent_ptr + offset();
+	}
+
+	void* ptr = glMapBufferRange(target, offset(), size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+	if (!ptr) {
+		std::cerr << "Stream buffer map failed\n";
+		throw std::runtime_error("Stream buffer map failed");
+	}
+	mapped = true;
+	return ptr;
+}
+
+void Stream_Buffer::unmap() {
+	if (mapped) {
+		glBindBuffer(target, buffer);
+		glUnmapBuffer(target);
+		mapped = false;
+	}
+}
+
+void Stream_Buffer::end_frame() {
+	if (!buffer) {
+		return;
+	}
+
+	if (fences[region]) {
+		glDeleteSync(fences[region]);
+	}
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	region         = (region + 1) % frames_in_flight;
+}
+
+void Stream_Buffer::allocate(std::size_t size) {
+	release();
+
+	region_size       = (size + alignment - 1) / alignment * alignment;
+	std::size_t total = region_size * frames_in_flight;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(target, buffer);
+
+	if (persistent) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(target, total, nullptr, flags);
+		persistent_ptr = static_cast<char*>(glMapBufferRange(target, 0, total, flags));
+		if (!persistent_ptr) {
+			std::cerr << "Persistent buffer map failed\n";
+			throw std::runtime_error("Persistent buffer map failed");
+		}
+	}
+	else {
+		glBufferData(target, total, nullptr, GL_STREAM_DRAW);
+	}
+}
+
+void Stream_Buffer::release() {
+	for (auto& fence : fences) {
+		if (fence) {
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+
+	if (buffer) {
+		unmap();
+		if (persistent_ptr) {
+			glBindBuffer(target, buffer);
+			glUnmapBuffer(target);
+			persistent_ptr = nullptr;
+		}
+		// GL keeps the storage alive until draws already using it are done
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+	}
+
+	region      = 0;
+	region_size = 0;
+}
+
+void Stream_Buffer::wait(std::size_t r) {
+	if (!fences[r]) {
+		return;
+	}
+
+	GLenum result = glClientWaitSync(fences[r], 0, 0);
+	while (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+		if (result == GL_WAIT_FAILED) {
+			std::cerr << "Stream buffer fence wait failed\n";
+			throw std::runtime_error("Stream buffer fence wait failed");
+		}
+		// One second, flushing so the fence can't wait on commands still sitting in the queue
+		result = glClientWaitSync(fences[r], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+	}
+
+	glDeleteSync(fences[r]);
+	fences[r] = nullptr;
+}
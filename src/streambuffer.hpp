@@ -0,0 +1,58 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+
+// Ring of per-frame regions in one buffer object for data rewritten every frame.
+//
+// With ARB_buffer_storage the whole buffer stays persistently mapped, otherwise
+// each region is mapped unsynchronized. Either way a fence per region makes
+// map() wait only if the GPU is still reading that region from frames_in_flight
+// frames ago, instead of glBufferData reallocating and copying every frame.
+class Stream_Buffer {
+  public:
+	static constexpr std::size_t frames_in_flight = 3;
+	// Regions start on this boundary so they can be bound as uniform, storage or texture buffer ranges too.
+	static constexpr std::size_t alignment = 256;
+
+	explicit Stream_Buffer(GLenum target);
+	Stream_Buffer(const Stream_Buffer&) = delete;
+	Stream_Buffer& operator=(const Stream_Buffer&) = delete;
+	~Stream_Buffer();
+
+	// Returns size writable bytes in this frame's region, or nullptr if size is 0.
+	// Leaves the buffer bound to its target. Growing recreates the buffer, so
+	// get_buffer() and offset() must be read again after every map().
+	void* map(std::size_t size);
+	void unmap();
+
+	// Fences this frame's region and moves on to the next. Call once all draws reading it are issued.
+	void end_frame();
+
+	GLuint get_buffer() const {
+		return buffer;
+	}
+	// Offset of this frame's region within get_buffer().
+	std::size_t offset() const {
+		return region * region_size;
+	}
+	bool is_persistent() const {
+		return persistent;
+	}
+
+  private:
+	void allocate(std::size_t size);
+	void release();
+	void wait(std::size_t region);
+
+	GLenum target;
+	GLuint buffer = 0;
+	bool persistent;
+	bool mapped = false;
+
+	char* persistent_ptr    = nullptr;
+	std::size_t region_size = 0;
+	std::size_t region      = 0;
+	GLsync fences[frames_in_flight] = {};
+};
@@ -1,8 +1,27 @@
 #include "util.hpp"
 
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#endif
 
 std::string file_contents(const char* filename) {
 	std::ifstream f(filename);
@@ -20,4 +39,149 @@ std::string file_contents(const char* filename) {
 	str.assign((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
 
 	return str;
-}
\ No newline at end of file
+}
+
+Mapped_File::Mapped_File(const char* filename) {
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		std::cerr << "Can't open " << filename << "\n";
+		return;
+	}
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) {
+		CloseHandle(file);
+		std::cerr << "Can't stat " << filename << "\n";
+		return;
+	}
+	length = static_cast<std::size_t>(file_size.QuadPart);
+
+	if (length != 0) {
+		HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (map != NULL) {
+			mapping = static_cast<const char*>(MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0));
+			CloseHandle(map);
+		}
+	}
+	CloseHandle(file);
+#else
+	int fd = ::open(filename, O_RDONLY);
+	if (fd == -1) {
+		std::cerr << "Can't open " << filename << "\n";
+		return;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) == -1) {
+		::close(fd);
+		std::cerr << "Can't stat " << filename << "\n";
+		return;
+	}
+	length = static_cast<std::size_t>(info.st_size);
+
+	if (length != 0) {
+		void* ptr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (ptr != MAP_FAILED) {
+			madvise(ptr, length, MADV_SEQUENTIAL);
+			mapping = static_cast<const char*>(ptr);
+		}
+	}
+	::close(fd);
+#endif
+
+	if (length != 0 && mapping == nullptr) {
+		std::cerr << "Can't map " << filename << "\n";
+		length = 0;
+		return;
+	}
+
+	open = true;
+}
+
+Mapped_File::Mapped_File(Mapped_File&& other) noexcept
+    : open(std::exchange(other.open, false)), mapping(std::exchange(other.mapping, nullptr)),
+      length(std::exchange(other.length, 0)) {}
+
+Mapped_File& Mapped_File::operator=(Mapped_File&& other) noexcept {
+	if (this != &other) {
+		close();
+		open    = std::exchange(other.open, false);
+		mapping = std::exchange(other.mapping, nullptr);
+		length  = std::exchange(other.length, 0);
+	}
+	return *this;
+}
+
+Mapped_File::~Mapped_File() {
+	close();
+}
+
+void Mapped_File::close() {
+	if (mapping) {
+#ifdef _WIN32
+		UnmapViewOfFile(mapping);
+#else
+		munmap(const_cast<char*>(mapping), length);
+#endif
+	}
+	open    = false;
+	mapping = nullptr;
+	length  = 0;
+}
+
+void* aligned_malloc(std::size_t size, std::size_t alignment) {
+#ifdef _WIN32
+	return _aligned_malloc(size, alignment);
+#else
+	void* ptr = nullptr;
+	if (posix_memalign(&ptr, alignment, size) != 0) {
+		return nullptr;
+	}
+	return ptr;
+#endif
+}
+
+void aligned_free(void* ptr) {
+#ifdef _WIN32
+	_aligned_free(ptr);
+#else
+	std::free(ptr);
+#endif
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+bool cpu_has_sse41() {
+	return __builtin_cpu_supports("sse4.1");
+}
+
+bool cpu_has_avx2() {
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+bool cpu_has_sse41() {
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 19)) != 0;
+}
+
+bool cpu_has_avx2() {
+	int info[4];
+	__cpuid(info, 1);
+	bool fma     = (info[2] & (1 << 12)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	if (!fma || !osxsave || (_xgetbv(0) & 0x6) != 0x6) {
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+}
+#else
+bool cpu_has_sse41() {
+	return false;
+}
+
+bool cpu_has_avx2() {
+	return false;
+}
+#endif
@@ -1,5 +1,78 @@
 #pragma once
 
+#include <cstddef>
+#include <new>
 #include <string>
 
-std::string file_contents(const char* filename);
\ No newline at end of file
+std::string file_contents(const char* filename);
+
+// Read-only memory mapping of an entire file.
+class Mapped_File {
+  public:
+	Mapped_File() = default;
+	explicit Mapped_File(const char* filename);
+	Mapped_File(const Mapped_File&) = delete;
+	Mapped_File(Mapped_File&& other) noexcept;
+	Mapped_File& operator=(const Mapped_File&) = delete;
+	Mapped_File& operator=(Mapped_File&& other) noexcept;
+	~Mapped_File();
+
+	bool is_open() const {
+		return open;
+	}
+	const char* data() const {
+		return mapping;
+	}
+	std::size_t size() const {
+		return length;
+	}
+
+  private:
+	void close();
+
+	bool open           = false;
+	const char* mapping = nullptr;
+	std::size_t length  = 0;
+};
+
+void* aligned_malloc(std::size_t size, std::size_t alignment);
+void aligned_free(void* ptr);
+
+// Allocator for SIMD friendly std::vector storage.
+template <class T, std::size_t Alignment = 32>
+struct Aligned_Allocator {
+	using value_type = T;
+
+	template <class U>
+	struct rebind {
+		using other = Aligned_Allocator<U, Alignment>;
+	};
+
+	Aligned_Allocator() = default;
+	template <class U>
+	Aligned_Allocator(const Aligned_Allocator<U, Alignment>&) {}
+
+	T* allocate(std::size_t n) {
+		void* ptr = aligned_malloc(n * sizeof(T), Alignment);
+		if (!ptr) {
+			throw std::bad_alloc();
+		}
+		return static_cast<T*>(ptr);
+	}
+	void deallocate(T* ptr, std::size_t) {
+		aligned_free(ptr);
+	}
+
+	template <class U>
+	bool operator==(const Aligned_Allocator<U, Alignment>&) const {
+		return true;
+	}
+	template <class U>
+	bool operator!=(const Aligned_Allocator<U, Alignment>&) const {
+		return false;
+	}
+};
+
+// Runtime CPU feature checks for picking SIMD kernels. Always false off x86.
+bool cpu_has_sse41();
+bool cpu_has_avx2(); // Also requires FMA and OS support for the ymm registers
@@ -0,0 +1,29 @@
+#include "vertexlayout.hpp"
+
+#include "meshcache.hpp"
+
+const Vertex_Layout float_vertex_layout = {
+    sizeof(Vertex),
+    {
+        {0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, x)},  // Position
+        {1, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, tx)}, // Texcoords
+        {2, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, nx)}, // Normals
+    },
+};
+
+const Vertex_Layout packed_vertex_layout = {
+    sizeof(Packed_Vertex),
+    {
+        {0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(Packed_Vertex, x)}, // Position, scaled by positionScale/Bias
+        {1, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(Packed_Vertex, tx)},   // Texcoords
+        {2, 2, GL_SHORT, GL_TRUE, offsetof(Packed_Vertex, nx)},         // Normals, octahedral encoded
+    },
+};
+
+void apply_vertex_layout(const Vertex_Layout& layout) {
+	for (auto& attr : layout.attributes) {
+		glVertexAttribPointer(attr.location, attr.components, attr.type, attr.normalized, static_cast<GLsizei>(layout.stride),
+		                      reinterpret_cast<const GLvoid*>(attr.offset));
+		glEnableVertexAttribArray(attr.location);
+	}
+}
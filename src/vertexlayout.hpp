@@ -0,0 +1,28 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <vector>
+
+// Describes how a vertex struct maps onto shader attribute locations.
+struct Vertex_Attribute {
+	GLuint location;
+	GLint components;
+	GLenum type;
+	GLboolean normalized;
+	std::size_t offset;
+};
+
+struct Vertex_Layout {
+	std::size_t stride;
+	std::vector<Vertex_Attribute> attributes;
+};
+
+// Vertex: 32 bytes of floats
+extern const Vertex_Layout float_vertex_layout;
+// Packed_Vertex: 16 bytes, see meshcache.hpp
+extern const Vertex_Layout packed_vertex_layout;
+
+// Points and enables every attribute of layout at the currently bound GL_ARRAY_BUFFER.
+void apply_vertex_layout(const Vertex_Layout& layout);
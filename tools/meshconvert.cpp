@@ -0,0 +1,33 @@
+#include <iostream>
+#include <stdexcept>
+
+#include "../src/meshcache.hpp"
+
+// Batch converts .wavobj files into their binary .mesh caches.
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		std::cerr << "Usage: " << argv[0] << " file.wavobj...\n";
+		return 1;
+	}
+
+	int ret = 0;
+	for (int i = 1; i < argc; ++i) {
+		try {
+			if (convert_mesh(argv[i])) {
+				Mapped_File source(argv[i]);
+				Mapped_File cache(mesh_cache_name(argv[i]).c_str());
+				std::cout << argv[i] << " -> " << mesh_cache_name(argv[i]) << " (" << source.size() / 1024 << "KB -> "
+				          << cache.size() / 1024 << "KB)\n";
+			}
+			else {
+				std::cerr << "Couldn't write " << mesh_cache_name(argv[i]) << '\n';
+				ret = 1;
+			}
+		}
+		catch (std::exception&) {
+			ret = 1;
+		}
+	}
+
+	return ret;
+}